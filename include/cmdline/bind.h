@@ -0,0 +1,98 @@
+//=================================================================================================
+// bind.h
+//  - bind options directly into the fields of a user struct
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace cmdline
+{
+
+// The converters from an option's string to a field are declared in cmdline.h, next
+// to get(), which uses them too.
+
+// A Binding is a table mapping option names to fields of T. Fields of any type can
+// be bound as long as there is a converter for them; the built-in converters above
+// are used unless one is supplied.
+//
+//    struct Config { int jobs; bool verbose; const char* repo; };
+//    static const cmdline::Binding<Config> binding {
+//        { "jobs", &Config::jobs },
+//        { "verbose", &Config::verbose },
+//        { "repository", &Config::repo },
+//    };
+//
+//    cmdline::Cmdline cmd(spec);
+//    Config config{ 1, false, nullptr };
+//    cmd.bind(config, binding);
+//    cmd.eval(argc, argv);
+template<typename T>
+class Binding
+{
+public:
+    class Field
+    {
+    public:
+        template<typename M>
+        Field(const char* name_, M T::* member_, bool (*conv_)(const char*, M&) = convert)
+            : name(name_)
+            , member(reinterpret_cast<char T::*>(member_))
+            , conv(reinterpret_cast<void (*)()>(conv_))
+            , apply(&Field::applyAs<M>)
+        {}
+
+        const char* name;
+
+    private:
+        friend class Cmdline;
+
+        // The member and converter are stored type-erased, and apply casts them back
+        // to the types they were bound with
+        template<typename M>
+        static bool applyAs(void* object, const void* field, const char* str)
+        {
+            auto f = static_cast<const Field*>(field);
+            auto member = reinterpret_cast<M T::*>(f->member);
+            auto conv = reinterpret_cast<bool (*)(const char*, M&)>(f->conv);
+            return conv(str, static_cast<T*>(object)->*member);
+        }
+
+        char T::* member;
+        void (*conv)();
+        bool (*apply)(void* object, const void* field, const char* str);
+    };
+
+    Binding(std::initializer_list<Field> fields_) : fields(fields_) {}
+
+    std::vector<Field> fields;
+};
+
+// Resolve each bound name to its Value now, so that eval() does no lookups. Returns false
+// (and adds to errorMsg) if a name isn't in the spec; that's the caller's mistake, not
+// the spec's, so failed is left alone and the other fields are still bound.
+template<typename T>
+bool Cmdline::bind(T& object, const Binding<T>& binding)
+{
+    bool ok = true;
+    for (auto& field : binding.fields)
+    {
+        int v = lookup(field.name);
+        if (v < 0)
+        {
+            errorMsg += std::string("bound field is not in the spec: ") + field.name + "\n";
+            ok = false;
+            continue;
+        }
+
+        bound.push_back(Bound{ v, &object, &field, field.apply });
+    }
+    return ok;
+}
+
+} // namespace cmdline
@@ -5,78 +5,766 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <string.h>
+#include <cstddef>
+#include <functional>
 #include <map>
+#include <memory>
+#include <new>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace cmdline
 {
 
+template<typename T> class Binding;
+class Converters;
+class OptionGroup;
+class Result;
+class SpecFile;
+
+// Converters from an option's string to a T, for get() and bound fields (see bind.h).
+// Each returns false if the string can't be converted, leaving out untouched.
+bool convert(const char* str, const char*& out);
+bool convert(const char* str, std::string& out);
+bool convert(const char* str, bool& out);
+bool convert(const char* str, int& out);
+bool convert(const char* str, long long& out);
+bool convert(const char* str, double& out);
+
+// A Fragment is a view of a run of characters in the spec or in argv. It does not own
+// the characters, and they are not necessarily nul-terminated.
+struct Fragment
+{
+    Fragment() : b(nullptr), e(nullptr) {}
+    Fragment(const char* b_, const char* e_) : b(b_), e(e_) {}
+    const char* b;
+    const char* e;
+};
+
+// Orders option names as std::string does, and also against a Fragment, so the option
+// map can be searched for a name in argv without copying it into a string
+struct NameLess
+{
+    typedef void is_transparent;
+    bool operator()(const std::string& a, const std::string& b) const { return a < b; }
+    bool operator()(const std::string& a, Fragment b) const { return a.compare(0, a.size(), b.b, b.e - b.b) < 0; }
+    bool operator()(Fragment a, const std::string& b) const { return b.compare(0, b.size(), a.b, a.e - a.b) > 0; }
+};
+
 // This holds a single value for an option. If the string is null, then the option
 // is not present
+//
+// An option can take a range of arguments (see nargs and maxArgs). When it has taken
+// more than one, they are available through arg() or args(). These are views into
+// argv: the first value is string(), and the rest are a run of argv entries, so
+// nothing is copied.
 class Value
 {
 public:
-    Value() : str(nullptr), valid(false), num_args(0) {}
-    Value(char* str_) : str(str_), valid(true), num_args(0) {}
-    Value(char* str_, bool f_) : str(str_), valid(f_), num_args(0) {}
+    enum { Many = 0x7fffffff }; // maxArgs for options with no upper limit
+
+    Value() : str(nullptr), rest(nullptr), valid(false), num_args(0), max_args(0), num_values(0) {}
+    Value(const char* str_) : str(str_), rest(nullptr), valid(true), num_args(0), max_args(0), num_values(1) {}
+    Value(const char* str_, bool f_) : str(str_), rest(nullptr), valid(f_), num_args(0), max_args(0), num_values(f_ ? 1 : 0) {}
+    Value(const char* str_, bool f_, int n_) : str(str_), rest(nullptr), valid(f_), num_args(n_), max_args(n_), num_values(f_ ? 1 : 0) {}
     ~Value() {}
 
     const char* string() const { return str; }
     bool exists() const { return valid; }
-    int nargs(int n = -1) { if (n >= 0) num_args = n; return num_args; }
 
-    void set(const char* s) { str = s; valid = true; }
-    const std::string print();
+    // The least and most arguments this option takes; nargs(n) sets both to n
+    int nargs() const { return num_args; }
+    int nargs(int n) { if (n >= 0) num_args = max_args = n; return num_args; }
+    int maxArgs() const { return max_args; }
+    void arity(int min, int max) { num_args = min; max_args = max; }
+
+    // The values actually supplied. count() is 1 for a flag or single value.
+    class Args;
+    int count() const { return num_values; }
+    const char* arg(int i) const { return i == 0 ? str : rest[i - 1]; }
+    Args args() const;
+
+    void set(const char* s) { str = s; rest = nullptr; valid = true; num_values = 1; }
+    void set(const char* first, const char* const* rest_, int n) { str = first; rest = rest_; valid = true; num_values = n; }
+    const std::string print() const;
+    void print(std::string& out) const; // appends
 private:
 	const char* str;
+    const char* const* rest; // values after the first
     bool valid;
-    int num_args; // number of arguments consumed
+    int num_args; // least number of arguments consumed
+    int max_args; // most number of arguments consumed
+    int num_values; // number of values supplied
+};
+
+// A zero-copy range over a Value's arguments
+class Value::Args
+{
+public:
+    class iterator
+    {
+    public:
+        iterator(const Value* v_, int i_) : v(v_), i(i_) {}
+        const char* operator*() const { return v->arg(i); }
+        iterator& operator++() { i++; return *this; }
+        bool operator!=(const iterator& rhs) const { return i != rhs.i; }
+    private:
+        const Value* v;
+        int i;
+    };
+
+    explicit Args(const Value* v_) : v(v_) {}
+    int size() const { return v->count(); }
+    const char* operator[](int i) const { return v->arg(i); }
+    iterator begin() const { return iterator(v, 0); }
+    iterator end() const { return iterator(v, v->count()); }
+private:
+    const Value* v;
+};
+
+inline Value::Args Value::args() const { return Args(this); }
+
+namespace internal
+{
+// The usage lines of a spec, compiled into a program that matches the positional
+// arguments (see usage.cpp). Jumps are relative to the instruction they're in.
+struct Usage
+{
+    enum Op { Arg, Word, Program, Split, Jmp, Match };
+    struct Inst
+    {
+        Op op;
+        int x; // Arg: slot, Word/Program: index in words, Split/Jmp: jump, Match: line
+        int y; // Split: second jump
+    };
+
+    // Options are matched as a set rather than in order; each line lists the options
+    // it allows, and the ones it requires
+    struct Line
+    {
+        bool anyOption; // [options] appeared
+        std::vector<std::string> allowed;
+        std::vector<std::string> required;
+        std::vector<int> allowedValues; // resolved by link
+        std::vector<int> requiredValues;
+    };
+
+    std::vector<Inst> code;
+    std::vector<std::string> words; // command words
+    std::vector<std::string> slots; // positional names
+    std::vector<int> slotValues;    // resolved by link
+    std::vector<std::pair<std::string, int>> optionArgs; // options with =<arg> in patterns
+    std::vector<Line> lines;
+
+    bool empty() const { return lines.empty(); }
+};
+
+// Constraints between options, declared in help text with (conflicts: ...), (requires: ...),
+// (implies: ...) and (exclusive: group), and compiled into bitmasks over value indices
+// (see constraints.cpp)
+struct Constraints
+{
+    enum Kind { Conflicts, Requires, Implies, Exclusive };
+    struct Declared
+    {
+        int value;
+        Kind kind;
+        std::string names; // as written, resolved by link
+    };
+    std::vector<Declared> declared;
+
+    // Each mask is a row of words per constrained value, found with rowOf (-1 for values
+    // without constraints); a value's bit is 1 << (v % 64) in word v / 64
+    int words = 0;
+    std::vector<int> rowOf;
+    std::vector<uint64_t> conflicts;
+    std::vector<uint64_t> required;
+    std::vector<uint64_t> implies;
+    std::vector<uint64_t> constrained; // values that have any constraint
+    std::vector<uint64_t> seen;        // scratch for eval
+    std::vector<std::string> names;    // name of each value, for errors
+};
+
+// Defaults declared in help text with (default: ...). Study only records where the text
+// is; it's copied out and converted the first time it's asked for.
+struct Defaults
+{
+    struct Entry
+    {
+        Fragment text; // view into the spec, empty if the value has no default
+        std::unique_ptr<char[]> str; // nul-terminated copy, made on first use
+        Value value;
+        const void* type = nullptr; // the type of converted, see TypeTag
+        std::shared_ptr<void> converted;
+    };
+    std::vector<Entry> entries; // by value
+
+    Entry* find(int v) { return v < (int) entries.size() && entries[v].text.b != nullptr ? &entries[v] : nullptr; }
+    const Value& materialize(Entry& entry, const Value& declared);
+};
+
+// The address of TypeTag<T>::id identifies T, for caches that hold any type
+template<typename T> struct TypeTag { static const char id; };
+template<typename T> const char TypeTag<T>::id = 0;
+
+// A converter from an option's string to a T, with the type erased. The function
+// object is kept in a small buffer inside the Converter rather than on the heap, which
+// is why it has to be small and trivially copyable: a function pointer, or a lambda
+// that captures a pointer or two. The result is constructed in storage the caller
+// provides.
+class Converter
+{
+public:
+    enum { BufferSize = 2 * sizeof(void*) };
+
+    template<typename T, typename F> static Converter make(F f)
+    {
+        static_assert(sizeof(F) <= BufferSize, "converter is too big to store inline; capture a pointer instead");
+        static_assert(std::is_trivially_copyable<F>::value, "converter must be trivially copyable");
+        static_assert(alignof(F) <= alignof(void*), "converter is over-aligned");
+        Converter c = shell<T>();
+        new (c.buffer) F(f);
+        c.run = [](const void* fn, const char* str, void* out, const char** bad) {
+            (void) bad;
+            T* t = new (out) T();
+            if ((*static_cast<const F*>(fn))(str, *t))
+                return true;
+            t->~T();
+            return false;
+        };
+        return c;
+    }
+
+    // The same for a function that also says where in str it failed
+    template<typename T> static Converter withOffsets(bool (*f)(const char* str, T& out, const char** bad))
+    {
+        typedef bool (*F)(const char*, T&, const char**);
+        Converter c = shell<T>();
+        new (c.buffer) F(f);
+        c.run = [](const void* fn, const char* str, void* out, const char** bad) {
+            T* t = new (out) T();
+            if ((*static_cast<const F*>(fn))(str, *t, bad))
+                return true;
+            t->~T();
+            return false;
+        };
+        return c;
+    }
+
+    // Construct a T at out from str. On failure, nothing is left constructed, and bad
+    // is where the converter found a problem, if it can tell.
+    bool convert(const char* str, void* out, const char** bad) const { *bad = nullptr; return run(buffer, str, out, bad); }
+
+    const void* type; // TypeTag<T>::id
+    size_t size;
+    size_t align;
+    bool (*run)(const void* fn, const char* str, void* out, const char** bad);
+    void (*destroy)(void* out);
+    alignas(void*) unsigned char buffer[BufferSize];
+
+private:
+    template<typename T> static Converter shell()
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "type is over-aligned");
+        Converter c;
+        c.type = &TypeTag<T>::id;
+        c.size = sizeof(T);
+        c.align = alignof(T);
+        c.destroy = [](void* out) { static_cast<T*>(out)->~T(); };
+        return c;
+    }
+};
+
+// Typed values, declared as <name:type> (see types.cpp). Study records the type names;
+// once it's done they're resolved to converters, and each typed value gets a slot in
+// one arena sized for all of them, so eval() converts without looking anything up or
+// allocating.
+struct Types
+{
+    struct Slot
+    {
+        int value;
+        Fragment name; // the option as declared, for errors
+        Fragment type; // the type name as written
+        Converter converter;
+        size_t offset; // of the result in the arena
+        bool constructed;
+    };
+    std::vector<Slot> slots;
+    std::vector<int> slotOf; // by value, -1 for untyped values
+    std::unique_ptr<std::max_align_t[]> arena;
+
+    Types() = default;
+    Types(const Types&) = delete;
+    Types& operator=(const Types&) = delete;
+    ~Types() { clear(); }
+
+    void* at(const Slot& slot) const { return reinterpret_cast<char*>(arena.get()) + slot.offset; }
+    const Slot* find(int v) const { return v >= 0 && v < (int) slotOf.size() && slotOf[v] >= 0 ? &slots[slotOf[v]] : nullptr; }
+
+    // Destroy the converted values
+    void clear()
+    {
+        for (auto& slot : slots)
+            if (slot.constructed)
+                slot.converter.destroy(at(slot)), slot.constructed = false;
+    }
+};
+
+// Argparse-style actions, declared in help text with (action: ...), and compiled into a
+// code per value (see actions.cpp). Values without one have Store: a flag is set to
+// "True", and an option to its last arguments. Constants are copied out of the spec
+// once, at study time, so eval() just points values at them.
+struct Actions
+{
+    enum Code : uint8_t { Store, StoreTrue, StoreFalse, StoreConst, Append, AppendConst, Count };
+    struct Slot
+    {
+        int value;
+        Code code;
+        Fragment text;        // the constant as written
+        const char* constant; // and as copied into pool
+        int count;            // times a Count flag was given in this eval()
+        char digits[12];      // count as a string
+    };
+    struct Item
+    {
+        int slot;
+        const char* str;
+    };
+
+    std::vector<uint8_t> codes;  // by value
+    std::vector<int> slotOf;     // by value, -1 for values without an action
+    std::vector<Slot> slots;
+    std::unique_ptr<char[]> pool;
+
+    // What eval() collects for Append and AppendConst, in argv order, and then the
+    // arguments of each, gathered so each is a run
+    std::vector<Item> items;
+    std::vector<const char*> appended;
+
+    Code code(int v) const { return v < (int) codes.size() ? (Code) codes[v] : Store; }
+    Slot& slot(int v) { return slots[slotOf[v]]; }
+};
+
+// Storage that eval() clears and reuses from one call to the next, so a Cmdline that
+// parses many command lines stops allocating once it has seen a long one
+struct Scratch
+{
+    // A positional argument and the value it was assigned to
+    struct Placed
+    {
+        int value;
+        int arg;
+    };
+
+    std::vector<int> args;       // positional arguments for the patterns, as argv indices
+    std::vector<int> used;       // values of the named options that appeared
+    std::vector<Placed> placed;  // positional arguments with their values
+    std::vector<char*> split;    // argv for a NUL-separated buffer
+
+    // A short option in a cluster such as -xzf, and where its code point starts
+    struct Clustered
+    {
+        int arg;
+        int value;
+        const char* at;
+    };
+
+    // The argv of the last eval(), and the named option each argument is or belongs
+    // to, or -1. A cluster belongs to its last option, and each option in it is also
+    // listed in clustered, in argv order (see forward.h).
+    int argc = 0;
+    char** argv = nullptr;
+    std::vector<int> owner;
+    std::vector<Clustered> clustered;
+};
+
+// The argv of a Cmdline made with Cmdline::Lazy, indexed but only evaluated an option
+// at a time, as they're asked for (see cmdline.cpp)
+struct Lazy
+{
+    // An argument before any "--" that looks like an option, and the value its name is
+    // for: -1 if it isn't one, -2 if it hasn't been looked up yet
+    struct Token
+    {
+        int arg;
+        Fragment name;
+        int value;
+    };
+
+    int argc;
+    char** argv;
+    std::vector<Token> tokens;
+    std::vector<char> resolved;   // by value
+    std::vector<char> positional; // by value
+};
+}
+
+// The pairs given to an option declared with a <key=value> value, from every time it
+// appeared, sorted by key:
+//
+//    -c, --config <key=value>    set a configuration variable
+//
+//    tool -c user.name=me -c core.pager=less -c user.name=you
+//    cmd.keyValues("config")->find("user.name") -> "you"
+//
+// Keys and values are views into argv, so nothing is copied: a key runs up to the first
+// '=' and isn't nul-terminated, and a value is the rest of the argument. A key given
+// more than once keeps its last value, unless the option was declared <key=value:@>,
+// in which case all of them are kept, in argv order.
+class KeyValues
+{
+public:
+    struct Pair
+    {
+        Fragment key;
+        const char* value;
+        int arg; // index in argv
+    };
+
+    KeyValues(int value_, bool list_) : value(value_), list(list_) {}
+
+    // The value for a key (the last, for a list), or null
+    const char* find(const char* key) const;
+
+    // Every pair with a key, in argv order
+    std::pair<const Pair*, const Pair*> all(const char* key) const;
+
+    const Pair* begin() const { return pairs.data(); }
+    const Pair* end() const { return pairs.data() + pairs.size(); }
+    int size() const { return (int) pairs.size(); }
+
+    int value; // the option's value index
+    bool list;
+    std::vector<Pair> pairs; // sorted by key, then arg, once eval() is done
+};
+
+// An Event is reported to handlers as eval() recognizes each option value or positional
+// argument, in argv order
+struct Event
+{
+    const char* name; // the name from the spec that matched
+    const char* str;  // the value, or "True" for a flag
+    int value;        // index of the option's value
+    int arg;          // index in argv the value came from
+    bool positional;
+};
+
+// One value of a parse, as listed by Cmdline::results() in the order the spec declares
+// them. Synonyms share a value, so each value is listed once, under its longest name.
+struct Parsed
+{
+    const char* name;  // as it's spelled in the spec, without dashes or brackets
+    const Value* value;
+    int arg;           // index in argv the value came from, or -1 if it wasn't given there
+    bool positional;
 };
 
 class Cmdline
 {
 public:
+    // Flags for how a spec is studied. With FoldCase, option names match regardless of
+    // case (see utf8.h for which letters fold); names are folded once at study time,
+    // and only argv names and lookups are folded after that.
+    //
+    // With Lazy, the argc/argv constructor doesn't evaluate argv. It makes one pass that
+    // notes which arguments look like options, and each named option is evaluated the
+    // first time it's asked for, through operator[], get() or typed(), and remembered.
+    // Each one walks the option-like arguments of argv, looking each name up only the
+    // first time, so a tool that reads two options pays for two walks of argv and not
+    // for the size of its spec, or for the options it never reads. Asking for a
+    // positional, a <key=value> table, results(), state(), dump() or freeze() evaluates
+    // the rest, as does complete(). Until then, badArgs and errorMsg don't cover the
+    // whole of argv, and handlers, usage lines, constraints and bindings haven't been
+    // applied; and where argv has an error, an option read lazily may differ from what
+    // eval() would have given it. Since reads write the cache, don't read one lazy
+    // Cmdline from several threads.
+    enum Flags { FoldCase = 1, Lazy = 2 };
+
     // Create a Cmdline object from a c-string spec and parse the supplied argv array
     // against the command-line spec
-	Cmdline(int argc, char** argv, char* spec);
-	~Cmdline();
+	Cmdline(int argc, char** argv, char* spec, int flags = 0);
+
+    // Create a Cmdline object from a c-string spec and study it, but don't parse anything
+    // yet; call eval() once any bindings have been made
+    Cmdline(char* spec, int flags = 0);
+
+    // The same, for a spec that runs to specEnd and needn't be nul-terminated
+    Cmdline(char* spec, char* specEnd, int flags = 0);
+
+    // The same, with the converters for <name:type> declarations (see types.h). Types
+    // are resolved while the spec is studied, and a name that isn't in types fails it;
+    // without this, only the built-in types are known. Converters are copied, so types
+    // needn't outlive the Cmdline.
+    Cmdline(char* spec, const Converters& types, int flags = 0);
+
+    // Create a Cmdline object from a spec file (see specfile.h) and study it. Names and
+    // help are views into the file's text, which the Cmdline keeps alive. If file is
+    // null (it couldn't be read), failed is set.
+    explicit Cmdline(std::shared_ptr<const SpecFile> file, int flags = 0);
+
+    // A Cmdline can be moved but not copied. Everything it owns is held by index or
+    // in containers whose storage moves with them, so a move is a handful of pointer
+    // swaps and nothing refers back into the old object. See docs/design.md for
+    // measured sizes, and footprint() for the heap side.
+    Cmdline(Cmdline&&) = default;
+    Cmdline& operator=(Cmdline&&) = default;
+    Cmdline(const Cmdline&) = delete;
+    Cmdline& operator=(const Cmdline&) = delete;
+
+    // footprint returns the (approximate) number of heap bytes owned by this object
+    size_t footprint() const;
 
 	// Use operator[] to get an option's value. If you ask for an option that wasn't actually
 	// presented on the command line, you'll get the noValue object and Value.exists will be false
-	const Value& operator[](const char* option);
+	// If it was declared but not given, and it has a (default: ...), you get a value
+	// whose string() is the default and exists() is still false. Defaults are copied out
+	// of the spec on first use, so don't read one Cmdline from several threads (freeze
+	// it instead).
+	const Value& operator[](const char* option) const;
+
+    // Get an option's value converted to T (see convert() below), falling back to
+    // its default. A converted default is cached, so asking again costs a lookup. Returns
+    // false if the option has no value or default, or it doesn't convert.
+    template<typename T> bool get(const char* option, T& out) const;
+
+    // The converted value of an option declared as <name:type>, where type converts
+    // to T, or null if the option isn't typed as T or has no value or default. The
+    // value lives in this Cmdline until the next eval().
+    template<typename T> const T* typed(const char* option) const;
+
+    // The pairs given to an option declared with a <key=value> value, or null if the
+    // option doesn't take them
+    const KeyValues* keyValues(const char* option) const;
 
     // usage returns a usage/help string
-    const std::string& usage();
+    const std::string& usage() const;
 
     // state returns internal state
-    const std::string state();
+    const std::string state() const;
+    void state(std::string& out) const; // appends
+
+    // Every value of the last eval(), in declaration order, with the argv index each one
+    // came from. The array is rebuilt only when the spec's values change, so later evals
+    // just update it; it points into this Cmdline, and is good until the next eval() or
+    // include().
+    const std::vector<Parsed>& results() const;
+
+    // Append results() to out, as one line per value or as a JSON object. Text lines
+    // name options as they're typed (-k, --jobs) and escape control characters in
+    // arguments, so one value is always one line. Nothing is allocated but out's own growth, so a buffer that's cleared and reused for each
+    // parse settles at no allocations at all.
+    enum DumpFormat { DumpText, DumpJson };
+    void dump(std::string& out, DumpFormat format = DumpText) const;
+
+    // Freeze the parse into an immutable Result (see result.h). The Result owns copies of
+    // everything it refers to, so it outlives this object and argv, and can be read from
+    // any number of threads at once.
+    std::shared_ptr<const Result> freeze() const;
+
+    // Bind the fields of a user struct to options (see bind.h). The names in the binding
+    // are resolved now, and converted values are written into object at the end of eval().
+    // Both object and binding must outlive the eval() call. Returns false if a name isn't
+    // in the spec.
+    template<typename T> bool bind(T& object, const Binding<T>& binding);
+
+    // Register a handler to be called as eval() recognizes an option or positional, so
+    // that work can start before the rest of argv is processed. Synonyms share handlers.
+    // If store is false, the value isn't kept in the Cmdline at all. Returns false if
+    // the option isn't in the spec.
+    typedef std::function<void(const Event&)> Handler;
+    bool on(const char* option, Handler handler, bool store = true);
+
+    // Register a handler that is called for every option and positional
+    void onAny(Handler handler);
+
+    // The index of the usage line that argv matched, or -1 if there are no usage lines
+    // or none matched
+    int usageLine() const { return matchedLine; }
 
     void study();
+
+    // Evaluate argv. Each eval() starts from the values study() and include() left,
+    // with no errors but those from the spec and bind(), so a Cmdline can be reused
+    // for one command line after another.
     void eval(int argc, char** argv);
 
+    // Evaluate whatever a Lazy Cmdline hasn't yet, exactly as eval() would have. It
+    // does nothing if argv has been evaluated already.
+    void complete();
+
+    // Parse NUL-separated arguments, the way the kernel keeps them in /proc/<pid>/cmdline,
+    // with args[0] the program. Values are views into args, which must outlive them; only
+    // an array of pointers is made, and it's reused by later calls. args[len] must be
+    // writable, and is set to nul, since a process that rewrote its arguments may have
+    // left the last one unterminated.
+    void eval(char* args, size_t len);
+
+    // Compose a shared option group into this parser (see group.h). Its options are
+    // found after this parser's own, through the group's index rather than a copy.
+    // Include groups before bind(), on() or eval().
+    void include(std::shared_ptr<const OptionGroup> group);
+
+    // The value index for a name, looking in this parser's options and then its groups,
+    // or -1. If name is given, it's set to the name as it appears in the spec.
+    int lookup(const char* b, const char* e, const std::string** name = nullptr) const;
+    int lookup(const char* name) const { return lookup(name, name + strlen(name)); }
+
+    // The entry in this parser's own options for a name, or null. Nothing is allocated
+    // unless a folded name is longer than any real option name.
+    const std::pair<const std::string, int>* findOption(const char* b, const char* e) const;
+
+    // True if a value belongs to an included group, and has a default there
+    bool groupDefault(int v) const;
+
+    // The option map key for a name from the spec, argv or a caller: the name itself, or
+    // its folded form with FoldCase
+    std::string key(const char* b, const char* e) const;
+    std::string key(const char* name) const;
+
     char* spec;
     char* specEnd;
+    std::shared_ptr<const SpecFile> specFile; // what spec points into, if it's a file
     std::string usageMsg;
     bool failed; // bad spec
+    bool badArgs; // bad command-line
+    bool foldCase; // names are case-insensitive
+    std::string errorMsg; // description of command-line errors, one per line
 
-    // This is our list of all command-line options, and their parsed values.
-    // TBD replace heavyweight std::string with interned strings?
-    std::map<std::string, Value*> options;
+    // This is our list of all command-line options, and the index of their parsed
+    // values. TBD replace heavyweight std::string with interned strings?
+    std::map<std::string, int, NameLess> options;
 
     // This is the list of values, held separately because two options can
     // point to the same value
-    std::vector<Value*> values;
+    std::vector<Value> values;
+
+    // These are the values as study() and include() left them, which each eval() starts
+    // from, and how much of errorMsg was there before the first eval() (npos until then)
+    std::vector<Value> initial;
+    size_t errorLength;
 
     // This is the ordered list of position arguments
     std::vector<std::string> positionals;
 
-    // This is a list of parameters split out of argv
-    std::vector<std::string> argv_parts;
+    // This is a list of parameters split out of argv. These are views into argv,
+    // so no strings are copied
+    std::vector<Fragment> argv_parts;
+
+    // This holds the values of positionals that took several arguments that weren't
+    // next to each other in argv
+    std::vector<const char*> gathered;
+
+    // These are the bound struct fields, written to at the end of eval()
+    struct Bound
+    {
+        int value;
+        void* object;
+        const void* field;
+        bool (*apply)(void* object, const void* field, const char* str);
+    };
+    std::vector<Bound> bound;
+
+    // These are the event handlers, indexed by value
+    struct Handlers
+    {
+        Handler handler;
+        bool store = true;
+    };
+    std::vector<Handlers> handlers;
+    Handler anyHandler;
+
+    // These are the compiled usage patterns (null if the spec has no usage lines), and
+    // the result of matching against them
+    std::unique_ptr<internal::Usage> usagePatterns;
+    int matchedLine;
+
+    // These are the compiled constraints between options (null if there are none)
+    std::unique_ptr<internal::Constraints> constraints;
+
+    // These are the defaults from the spec (null if there are none)
+    std::unique_ptr<internal::Defaults> defaults;
+
+    // These are the typed values and their converted results (null if there are none)
+    std::unique_ptr<internal::Types> types;
+
+    // These are the pairs collected for <key=value> options
+    std::vector<KeyValues> keyValueTables;
+
+    // These are the declared actions (null if there are none)
+    std::unique_ptr<internal::Actions> actions;
+
+    // These are the included option groups, and where their values start
+    struct Included
+    {
+        std::shared_ptr<const OptionGroup> group;
+        int base;
+    };
+    std::vector<Included> groups;
+
+    // This is the parse in declaration order, indexed by value (see results())
+    std::vector<Parsed> parsed;
+
+    // This is what eval() keeps between calls (null until the first)
+    std::unique_ptr<internal::Scratch> scratch;
+
+    // This is the argv of a Lazy Cmdline, while any of it is still unevaluated
+    std::unique_ptr<internal::Lazy> lazy;
 
     // This is the default empty value, currently only used when operator[] can't find
     // an entry
 	Value noValue;
+
+private:
+    Cmdline(char* spec, char* specEnd, const Converters* types, int flags);
+    void study(const Converters& converters);
+    void index(int argc, char** argv);
+    void resolve(int v) const;
 };
 
+template<typename T>
+bool Cmdline::get(const char* option, T& out) const
+{
+    int v = lookup(option);
+    if (v < 0)
+        return false;
+    if (lazy)
+        resolve(v);
+
+    // Included groups have their defaults in place already
+    const Value& value = values[v];
+    if (value.exists() || groupDefault(v))
+        return convert(value.string(), out);
+
+    internal::Defaults::Entry* entry = defaults ? defaults->find(v) : nullptr;
+    if (entry == nullptr)
+        return false;
+    if (entry->type != &internal::TypeTag<T>::id)
+    {
+        T converted;
+        if (!convert(defaults->materialize(*entry, value).string(), converted))
+            return false;
+        entry->converted = std::make_shared<T>(converted);
+        entry->type = &internal::TypeTag<T>::id;
+    }
+    out = *static_cast<const T*>(entry->converted.get());
+    return true;
+}
+
+template<typename T>
+const T* Cmdline::typed(const char* option) const
+{
+    int v = lookup(option);
+    if (lazy)
+        resolve(v);
+    const internal::Types::Slot* slot = types ? types->find(v) : nullptr;
+    if (slot == nullptr || !slot->constructed || slot->converter.type != &internal::TypeTag<T>::id)
+        return nullptr;
+    return static_cast<const T*>(types->at(*slot));
+}
+
 }
@@ -0,0 +1,315 @@
+//=================================================================================================
+// fixed.h
+//  - command-line parser with fixed-capacity storage and no heap allocations
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/spec.h"
+
+#include <string.h>
+
+namespace cmdline
+{
+
+// A FixedCmdline parses the same specs as Cmdline, but every option, value and split
+// argument is kept in arrays inside the object, so neither study nor eval touches the
+// heap. MaxOptions bounds the number of option names (synonyms and positionals each
+// count), and MaxArgs bounds the number of arguments in argv.
+//
+// If a limit is exceeded, parsing stops and error() is Error::Capacity. Nothing is
+// truncated silently.
+//
+//    cmdline::FixedCmdline<32, 16> cmd(argc, argv, spec);
+//    if (cmd.error() != cmdline::FixedError::None)
+//        puts(cmd.errorMessage());
+enum class FixedError
+{
+    None,
+    Capacity,           // more options or arguments than the template allows
+    BadSpec,            // the spec didn't parse
+    UnknownOption,      // an option in argv isn't in the spec
+    UnexpectedArgument, // more positional arguments than the spec has
+    MissingValue,       // an option's value is missing at the end of argv
+};
+
+template<int MaxOptions, int MaxArgs>
+class FixedCmdline : private internal::SpecSink
+{
+public:
+    FixedCmdline(int argc, char** argv, const char* spec_)
+        : spec(spec_), numNames(0), numValues(0), numPositionals(0), numParts(0)
+        , err(FixedError::None), errArg(-1)
+    {
+        specEnd = spec + strlen(spec);
+
+        // Skip leading newlines, the same as Cmdline does
+        while ((spec < specEnd && spec[0] == '\n')
+            || (spec+1 < specEnd && spec[0] == '\r' && spec[1] == '\n')
+        )
+            spec += 1;
+
+        if (!internal::study(spec, specEnd, *this))
+        {
+            if (err == FixedError::None)
+                err = FixedError::BadSpec;
+            return;
+        }
+
+        eval(argc, argv);
+    }
+
+    FixedCmdline(const FixedCmdline&) = delete;
+    FixedCmdline& operator=(const FixedCmdline&) = delete;
+
+	// Options not in the spec return noValue, where exists() is false
+    const Value& operator[](const char* option) const
+    {
+        int n = find(option, option + strlen(option));
+        return n < 0 ? noValue : values[names[n].value];
+    }
+
+    // The spec is the usage message, as for Cmdline
+    const char* usage() const { return spec; }
+
+    FixedError error() const { return err; }
+    int errorArg() const { return errArg; } // index in argv of the bad argument, or -1
+    const char* errorMessage() const
+    {
+        switch (err)
+        {
+        case FixedError::None: return "no error";
+        case FixedError::Capacity: return "too many options or arguments for this parser";
+        case FixedError::BadSpec: return "bad spec";
+        case FixedError::UnknownOption: return "unknown option";
+        case FixedError::UnexpectedArgument: return "unexpected argument";
+        case FixedError::MissingValue: return "missing value for option";
+        }
+        return "unknown error";
+    }
+
+    // The pieces split out of --option=value arguments, as views into argv
+    int parts() const { return numParts; }
+    Fragment part(int i) const { return argvParts[i]; }
+
+private:
+    struct Name
+    {
+        Fragment name;
+        int value;
+    };
+
+    // --- SpecSink -------------------------------------------------------------------------------
+
+    int value(bool named) override
+    {
+        if (numValues == MaxOptions)
+        {
+            fail(FixedError::Capacity, -1);
+            return -1;
+        }
+        values[numValues] = named ? Value("False", false) : Value();
+        return numValues++;
+    }
+
+    bool positional(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        (void) minArgs;
+        (void) maxArgs; // positionals take one argument each here
+        if (numPositionals == MaxOptions)
+            return fail(FixedError::Capacity, -1);
+        if (!insert(name, v))
+            return false;
+        positionals[numPositionals++] = v;
+        return true;
+    }
+
+    bool named(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        if (maxArgs > 0)
+            values[v].arity(minArgs, maxArgs);
+        return insert(name, v);
+    }
+
+    // --- names ----------------------------------------------------------------------------------
+
+    // Names are kept sorted by insertion so lookups can binary search. As with Cmdline,
+    // a repeated name rebinds to the latest value.
+    bool insert(Fragment name, int v)
+    {
+        int lo = lowerBound(name.b, name.e);
+        if (lo < numNames && compare(names[lo].name, name.b, name.e) == 0)
+        {
+            names[lo].value = v;
+            return true;
+        }
+
+        if (numNames == MaxOptions)
+            return fail(FixedError::Capacity, -1);
+        for (int i = numNames; i > lo; i--)
+            names[i] = names[i - 1];
+        names[lo] = Name{ name, v };
+        numNames += 1;
+        return true;
+    }
+
+    static int compare(Fragment a, const char* b, const char* e)
+    {
+        size_t alen = a.e - a.b;
+        size_t blen = e - b;
+        int c = memcmp(a.b, b, alen < blen ? alen : blen);
+        if (c != 0)
+            return c;
+        return alen < blen ? -1 : alen > blen ? 1 : 0;
+    }
+
+    int lowerBound(const char* b, const char* e) const
+    {
+        int lo = 0;
+        int hi = numNames;
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (compare(names[mid].name, b, e) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    int find(const char* b, const char* e) const
+    {
+        int n = lowerBound(b, e);
+        if (n < numNames && compare(names[n].name, b, e) == 0)
+            return n;
+        return -1;
+    }
+
+    bool fail(FixedError e, int arg)
+    {
+        if (err == FixedError::None)
+        {
+            err = e;
+            errArg = arg;
+        }
+        return false;
+    }
+
+    // --- eval -----------------------------------------------------------------------------------
+
+    // This follows Cmdline::eval, except that option names are compared as views into
+    // argv instead of being copied out. Usage patterns aren't matched; positionals are
+    // assigned in the order they were declared.
+    void eval(int argc, char** argv)
+    {
+        if (argc - 1 > MaxArgs)
+        {
+            fail(FixedError::Capacity, MaxArgs + 1);
+            return;
+        }
+
+        int positional = 0;
+        bool optionsEnded = false;
+        for (int i = 1; i < argc; i++)
+        {
+            if (!optionsEnded && strcmp(argv[i], "--") == 0)
+            {
+                optionsEnded = true;
+                continue;
+            }
+
+            if (optionsEnded || argv[i][0] != '-' || argv[i][1] == '\0')
+            {
+                if (positional >= numPositionals)
+                {
+                    fail(FixedError::UnexpectedArgument, i);
+                    return;
+                }
+                values[positionals[positional++]].set(argv[i]);
+                continue;
+            }
+
+            const char* opt = argv[i];
+            if (*opt == '-') opt++;
+            if (*opt == '-') opt++;
+
+            const char* eq = strchr(opt, '=');
+            const char* optEnd = eq != nullptr ? eq : opt + strlen(opt);
+            const char* optVal = nullptr;
+            if (eq != nullptr)
+            {
+                // Two parts per argument, and there are at most MaxArgs arguments
+                argvParts[numParts++] = Fragment(opt, eq);
+                argvParts[numParts++] = Fragment(eq + 1, eq + 1 + strlen(eq + 1));
+                optVal = eq + 1;
+            }
+
+            int n = find(opt, optEnd);
+            if (n < 0)
+            {
+                fail(FixedError::UnknownOption, i);
+                return;
+            }
+
+            Value& value = values[names[n].value];
+            if (value.maxArgs() == 0)
+            {
+                value.set("True");
+                continue;
+            }
+
+            // Take values greedily up to the most allowed, stopping at the next option
+            int at = i;
+            int count = optVal != nullptr ? 1 : 0;
+            while (count < value.maxArgs() && i + 1 < argc && !isOption(argv[i + 1]))
+            {
+                i += 1;
+                count += 1;
+            }
+            if (count < value.nargs())
+            {
+                fail(FixedError::MissingValue, at);
+                return;
+            }
+            if (count > 0)
+            {
+                if (optVal != nullptr)
+                    value.set(optVal, &argv[at + 1], count);
+                else
+                    value.set(argv[at + 1], &argv[at + 2], count);
+            }
+        }
+    }
+
+    bool isOption(const char* arg) const
+    {
+        if (arg[0] != '-' || arg[1] == '\0')
+            return false;
+        const char* opt = arg + 1;
+        if (*opt == '-') opt++;
+        if (*opt == '\0')
+            return true; // "--"
+        const char* eq = strchr(opt, '=');
+        return find(opt, eq != nullptr ? eq : opt + strlen(opt)) >= 0;
+    }
+
+    const char* spec;
+    const char* specEnd;
+
+    Name names[MaxOptions];
+    int numNames;
+    Value values[MaxOptions];
+    int numValues;
+    int positionals[MaxOptions];
+    int numPositionals;
+    Fragment argvParts[2 * MaxArgs];
+    int numParts;
+
+    FixedError err;
+    int errArg;
+
+	Value noValue;
+};
+
+} // namespace cmdline
@@ -0,0 +1,97 @@
+//=================================================================================================
+// forward.h
+//  - building a child's argv from a parse, for wrappers and launchers
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cmdline
+{
+
+// An ArgvBuilder makes a new argv from an evaluated Cmdline's argv, for a wrapper to
+// pass on to the program it runs:
+//
+//    cmdline::ArgvBuilder child(cmd);
+//    child.program("/usr/bin/make");
+//    child.drop("dry-run");               // ours, not make's
+//    child.set("jobs", "16");             // -j 16, in place of any -j given
+//    child.add({ "--no-print-directory" });
+//    execv(child.argv()[0], child.build());
+//
+// Arguments that aren't edited are passed through as the original argv pointers, not
+// copied, so argv must outlive the result. An option is dropped or replaced with the
+// arguments it took, wherever it appeared; a replacement goes where the option first
+// appeared. Added arguments, and options set that weren't given, go before a "--", or
+// at the end if there isn't one. A cluster of short flags with an edited option in it,
+// like -xzf, is split: the edits go in its place, followed by the rest of the cluster,
+// so its last option keeps any arguments after it.
+//
+// Strings given to the edits are copied as they're made, into one buffer; build() then
+// makes the new argv with a single allocation, holding the array, those strings and any
+// clusters it rebuilt.
+class ArgvBuilder
+{
+public:
+    // A lazy Cmdline is completed first
+    explicit ArgvBuilder(Cmdline& cmd);
+
+    ArgvBuilder(const ArgvBuilder&) = delete;
+    ArgvBuilder& operator=(const ArgvBuilder&) = delete;
+
+    // Replace argv[0]
+    void program(const char* name);
+
+    // Leave an option out, with its arguments. Returns false if it isn't in the spec.
+    bool drop(const char* option);
+
+    // Put args in place of an option, if it was given. Returns false if it isn't in the
+    // spec.
+    bool replace(const char* option, std::initializer_list<const char*> args);
+    bool replace(const char* option, const char* const* args, int n);
+
+    // Give an option a value, as -o value or --option=value, or as a flag if value is
+    // null, in place of where it was given or else added. Returns false if it isn't in
+    // the spec.
+    bool set(const char* option, const char* value = nullptr);
+
+    // Add arguments
+    void add(std::initializer_list<const char*> args);
+    void add(const char* const* args, int n);
+
+    // Make the new argv, null-terminated. It's good until the next build() or the
+    // builder is destroyed.
+    char** build();
+    int argc() const { return count; }
+    char** argv() const { return block.get(); }
+
+private:
+    struct Edit
+    {
+        int value;  // -1 for added arguments
+        int first;  // in offsets
+        int n;
+        bool orAdd; // add it if the option wasn't given
+        bool placed;
+    };
+
+    int copy(const char* str);
+    Edit* find(int v);
+    int emit(char** out, char* strings, size_t& rebuilt);
+
+    Cmdline& cmd;
+    const char* programName;
+    std::vector<Edit> edits;
+    std::vector<size_t> offsets; // of each new argument in text
+    std::string text;            // the new arguments, each nul-terminated
+    std::unique_ptr<char*[]> block;
+    int count;
+};
+
+} // namespace cmdline
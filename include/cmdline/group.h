@@ -0,0 +1,74 @@
+//=================================================================================================
+// group.h
+//  - option groups studied once and shared between parsers
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cmdline
+{
+
+// An OptionGroup is a spec fragment, such as a set of global options, that is studied
+// once and then included by reference into any number of parsers:
+//
+//    static auto global = cmdline::OptionGroup::study(R"raw(
+//        -v, --verbose         be more verbose
+//        -c, --config <file>   configuration file (default: ~/.toolrc)
+//    )raw");
+//
+//    cmdline::Cmdline cmd(subcommandSpec);
+//    cmd.include(global);
+//    cmd.eval(argc, argv);
+//    if (cmd["verbose"].exists()) ...
+//
+// A group never changes after it is studied, so it can be shared between threads. A
+// parser that includes it keeps a reference, and adds only a Value per option for its
+// own parse; names that aren't in the parser's own spec are looked up in its groups,
+// in the order they were included. Defaults in a group are copied out of its spec when
+// the group is studied. Usage lines and constraints in a group apply only inside it, so
+// they're ignored by parsers that include it.
+class OptionGroup
+{
+public:
+    static std::shared_ptr<const OptionGroup> study(const char* spec, int flags = 0);
+
+    // Study a spec file (see specfile.h) without copying it; the group keeps it alive
+    static std::shared_ptr<const OptionGroup> study(std::shared_ptr<const SpecFile> file, int flags = 0);
+
+    OptionGroup(const OptionGroup&) = delete;
+    OptionGroup& operator=(const OptionGroup&) = delete;
+
+    // The name and index of a name's value within the group, or null
+    const std::pair<const std::string, int>* find(const char* b, const char* e) const;
+
+    // The names and their value indices, in sorted order
+    const std::map<std::string, int, NameLess>& names() const { return cmd.options; }
+
+    // The value each option starts out with in a parse, including its default
+    int size() const { return (int) initial.size(); }
+    const Value& value(int v) const { return initial[v]; }
+    bool hasDefault(int v) const { return initial[v].string() != cmd.values[v].string(); }
+
+    bool failed() const { return cmd.failed; }
+    const std::string& errors() const { return cmd.errorMsg; }
+    const std::string& usage() const { return cmd.usage(); }
+
+private:
+    friend class SpecRegistry;
+    OptionGroup(const char* spec, int flags);
+    OptionGroup(std::shared_ptr<const SpecFile> file, int flags);
+    void materialize();
+
+    std::unique_ptr<char[]> text; // our copy of the spec, which cmd points into, if not a file
+    Cmdline cmd;
+    std::vector<Value> initial;
+};
+
+} // namespace cmdline
@@ -0,0 +1,92 @@
+//=================================================================================================
+// procscan.h
+//  - classifying running processes by parsing their command lines against tool specs
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cmdline
+{
+
+// A ProcScanner sweeps /proc, and parses the command line of each process whose
+// program is one of a set of known tools against that tool's spec:
+//
+//    cmdline::ProcScanner scanner;
+//    int rsync = scanner.add("rsync", rsyncSpec);
+//    int ssh = scanner.add("ssh", sshSpec);
+//
+//    // every few seconds
+//    scanner.scan([](const cmdline::ProcScanner::Process& p) {
+//        if (p.tool == ssh) report(p.pid, (*p.cmd)["l"].string());
+//    });
+//
+// A process's tool is picked by the last path component of its argv[0], and its
+// /proc/<pid>/cmdline is parsed in place with Cmdline::eval(char*, size_t). Processes
+// are split between worker threads, and each worker keeps its own read buffer and a
+// Cmdline per tool, studied on the first scan, which it resets rather than rebuilds
+// for each process. So once the buffers have grown to the longest command line seen,
+// a scan allocates nothing per process.
+//
+// Processes that exit mid-scan, or whose cmdline can't be read (kernel threads have an
+// empty one), are skipped.
+class ProcScanner
+{
+public:
+    explicit ProcScanner(const char* root = "/proc");
+    ~ProcScanner();
+
+    ProcScanner(const ProcScanner&) = delete;
+    ProcScanner& operator=(const ProcScanner&) = delete;
+
+    // Add a tool, returning its index. The spec is copied. Add tools before scanning.
+    int add(const char* program, const char* spec, int flags = 0);
+
+    // A process that matched a tool. cmd is the parse, which (like the strings it points
+    // to) is only good during the call.
+    struct Process
+    {
+        int pid;
+        int tool;
+        const Cmdline* cmd;
+    };
+    typedef std::function<void(const Process&)> Visitor;
+
+    // Scan once, calling visit for each process that matched a tool. It's called from
+    // the worker threads, so it has to be safe to call concurrently. threads is how many
+    // workers to use, or 0 for one per core. Returns how many processes were parsed.
+    int scan(const Visitor& visit, int threads = 0);
+
+    // Errors from studying the specs, if any failed; a tool whose spec failed is skipped
+    const std::string& errors() const { return specErrors; }
+
+private:
+    struct Tool
+    {
+        std::string program;
+        std::unique_ptr<char[]> spec;
+        int flags;
+    };
+    struct Worker;
+
+    int find(const char* program, size_t len) const;
+    void listPids();
+    int run(Worker& worker, const Visitor& visit);
+
+    std::string root;
+    std::vector<Tool> tools;
+    std::vector<int> byName;  // tool indices sorted by program
+    std::vector<int> pids;    // from the last listing
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::string specErrors;
+    std::atomic<int> next;    // in pids, for the workers to claim batches from
+};
+
+} // namespace cmdline
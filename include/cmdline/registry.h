@@ -0,0 +1,87 @@
+//=================================================================================================
+// registry.h
+//  - spec fragments declared across translation units and merged on first use
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/group.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace cmdline
+{
+
+class SpecRegistry;
+
+// A SpecFragment declares some of a program's options next to the code that uses them,
+// rather than in one spec in main():
+//
+//    // net/server.cpp
+//    static cmdline::SpecFragment serverOptions(R"raw(
+//        --port <port:int>     port to listen on (default: 8080)
+//        --backlog <n:int>     listen queue length (default: 128)
+//    )raw");
+//
+//    // main.cpp
+//    cmdline::Cmdline cmd(mainSpec);
+//    cmd.include(cmdline::SpecRegistry::global().merged());
+//    cmd.eval(argc, argv);
+//
+// Registering a fragment during static initialization only pushes it onto a lock-free
+// list (so it's also safe from libraries loaded on other threads); nothing is parsed
+// until merged() is first called. The text isn't copied, so it must outlive the
+// registry, as a string literal does.
+class SpecFragment
+{
+public:
+    explicit SpecFragment(const char* text, SpecRegistry& registry);
+    explicit SpecFragment(const char* text);
+
+    SpecFragment(const SpecFragment&) = delete;
+    SpecFragment& operator=(const SpecFragment&) = delete;
+
+    const char* text() const { return spec; }
+    const SpecFragment* next() const { return link; }
+
+private:
+    friend class SpecRegistry;
+    const char* spec;
+    SpecFragment* link;
+};
+
+// A SpecRegistry is a list of fragments. There's a global one, which SpecFragment uses
+// by default, and it can be constant-initialized, so it's ready before any static
+// constructor runs.
+//
+// merged() studies the fragments the first time it's called, in the order they were
+// registered, into one OptionGroup: a single index over every fragment's options, which
+// is then shared. An option declared in two fragments fails the group, since which one
+// wins would depend on link order. Fragments registered after the merge aren't in it.
+class SpecRegistry
+{
+public:
+    constexpr SpecRegistry() : head(nullptr) {}
+
+    SpecRegistry(const SpecRegistry&) = delete;
+    SpecRegistry& operator=(const SpecRegistry&) = delete;
+
+    static SpecRegistry& global();
+
+    std::shared_ptr<const OptionGroup> merged();
+
+    // The most recently registered fragment; follow next() for the rest
+    const SpecFragment* first() const { return head.load(std::memory_order_acquire); }
+
+private:
+    friend class SpecFragment;
+    void push(SpecFragment* fragment);
+
+    std::atomic<SpecFragment*> head;
+    std::once_flag once;
+    std::shared_ptr<const OptionGroup> group;
+};
+
+} // namespace cmdline
@@ -0,0 +1,138 @@
+//=================================================================================================
+// result.h
+//  - immutable, shareable parse results
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+namespace cmdline
+{
+
+// A Result is a frozen copy of an evaluated Cmdline. Everything is packed into a single
+// block: a header, an entry per option sorted by name, the positional order, and then
+// all the strings. Strings are referenced by offset from the start of the block, so
+// nothing in it points outside itself.
+//
+// Nothing in a Result changes after it is built, so any number of threads can read
+// one concurrently without locking. Share it with std::shared_ptr<const Result>, which
+// is what Cmdline::freeze() returns.
+//
+// Since the block is position-independent, it can also be handed to another process.
+// A supervisor can write() it to a memfd or file that its workers inherit, and each
+// worker map()s it and reads its options with no study() or eval(), and no copy:
+//
+//    // parent                             // child, after exec
+//    int fd = memfd_create("args", 0);     auto args = cmdline::Result::map(3);
+//    cmd.freeze()->write(fd);              int jobs = atoi((*args)["jobs"].string());
+//
+// The block is in the writer's byte order, so the reader must run on the same kind of
+// machine. Adopting a block checks that every offset in it stays inside it, which
+// takes time linear in the number of options and arguments.
+class Result
+{
+public:
+    explicit Result(const Cmdline& cmd);
+
+    // Use a block that the caller keeps alive and unchanged, such as a shared memory
+    // mapping, without copying it. Returns null if the header doesn't describe a block
+    // of this size, an offset in it points outside it, or data isn't 4-byte aligned.
+    static std::shared_ptr<const Result> adopt(const void* data, size_t size);
+
+    // Map a block from a file descriptor, or read it if the descriptor can't be mapped
+    // (a pipe, say). Returns null on a read error or a bad header. The fd can be closed
+    // afterwards.
+    static std::shared_ptr<const Result> map(int fd);
+
+    // Write the block to a file descriptor, for map() to pick up
+    bool write(int fd) const;
+
+    Result(const Result&) = delete;
+    Result& operator=(const Result&) = delete;
+    Result(Result&&) = default;
+    Result& operator=(Result&&) = default;
+
+    // Look up an option. Options not in the spec return a Value where exists() is false.
+    // The Value's string points into this Result.
+    Value operator[](const char* option) const;
+
+    // The usage/help text, and any command-line errors
+    const char* usage() const;
+    const char* errors() const;
+
+    bool failed() const;  // bad spec
+    bool badArgs() const; // bad command-line
+
+    // Names of positional arguments, in order
+    int positionals() const;
+    const char* positional(int i) const;
+
+    // The packed block
+    const char* data() const { return base; }
+    size_t size() const { return blobSize; }
+
+    // Layout of the packed block. A zero string offset means "no string".
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t numOptions;
+        uint32_t numPositionals;
+        uint32_t usage;
+        uint32_t errors;
+        uint32_t flags;
+        uint32_t numRest; // offsets of extra arguments, after the positionals
+    };
+
+    // An entry that took several arguments has count > 1, and rest is the offset of an
+    // array of count - 1 string offsets for the arguments after the first
+    struct Entry
+    {
+        uint32_t name;
+        uint32_t str;
+        int32_t nargs;
+        int32_t maxArgs;
+        uint32_t count;
+        uint32_t rest;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    enum : uint32_t
+    {
+        Magic = 0x52444d43, // "CMDR"
+        EntryExists = 1,
+        ResultFailed = 1,
+        ResultBadArgs = 2,
+        ResultFoldCase = 4, // names were folded, so lookups are too
+    };
+
+private:
+    Result(const char* data, size_t size, std::shared_ptr<const void> keep);
+    static bool check(const void* data, size_t size);
+
+    const Header& header() const;
+    const Entry* entries() const;
+    const uint32_t* positionalEntries() const;
+    const char* string(uint32_t offset) const;
+
+    void link();
+
+    std::unique_ptr<char[]> blob;       // the block, when this Result made it
+    std::shared_ptr<const void> mapped; // or the mapping it's in, for map()
+    const char* base;
+    size_t blobSize;
+
+    // Values hand out arrays of string pointers, so these are made from the offsets
+    // in the block when the Result is built or adopted. Only options that took several
+    // arguments need them, so most adopted blocks have none.
+    std::vector<const char*> restPointers;
+};
+
+} // namespace cmdline
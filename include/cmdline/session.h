@@ -0,0 +1,127 @@
+//=================================================================================================
+// session.h
+//  - incremental re-parsing of a line as it's edited, for interactive front ends
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace cmdline
+{
+
+// A Session keeps a command line and its parse, and re-parses only what an edit can
+// have changed. It writes into the values of a studied Cmdline that hasn't been given
+// an argv, and which must outlive it; read the values through the Cmdline as usual.
+//
+//    cmdline::Cmdline cmd(spec);
+//    cmdline::Session session(cmd);
+//    session.update(line, len); // on every keystroke
+//    hint(cmd["output"], session.error());
+//
+// The line is split at whitespace (there's no quoting), and the arguments are parsed
+// the way eval() parses argv, clusters of short flags and flag actions included. Usage
+// patterns, handlers, bindings, constraints and types aren't applied, an appended
+// option keeps only its last arguments, and a positional that takes several arguments
+// takes them from one run.
+//
+// Each parse step (an option with its arguments, or a positional) saves the scanner
+// state and the values it overwrote. An edit resumes from the step before the first
+// changed argument, since that step may have looked ahead at it, so the work is
+// proportional to the edit and not to the line. Storage grows to the longest line seen
+// and is reused after that, so steady-state updates don't allocate.
+class Session
+{
+public:
+    explicit Session(Cmdline& cmd, size_t reserve = 256);
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // Replace the line with a new version; only the part after the common prefix is
+    // re-parsed
+    void update(const char* line, size_t len);
+
+    // Replace erase bytes at offset at with len bytes of text
+    void edit(size_t at, size_t erase, const char* text, size_t len);
+
+    // The arguments of the line, nul-terminated, with argv[0] empty
+    int argc() const { return (int) args.size(); }
+    char* const* argv() const { return args.data(); }
+
+    // The first error in the line, or nullptr, and the argument it's at
+    const char* error() const { return state.error; }
+    int errorArg() const { return state.errorArg; }
+
+    // How many arguments the last update or edit parsed again
+    int reparsed() const { return numReparsed; }
+
+private:
+    struct Name
+    {
+        const char* name;
+        size_t len;
+        int value;
+    };
+
+    struct State
+    {
+        int positional;      // index of the next positional
+        bool optionsEnded;   // seen "--"
+        const char* error;
+        int errorArg;
+    };
+
+    // Where a step started, what it could see, and how to undo it
+    struct Step
+    {
+        int arg;      // first argument of the step
+        int last;     // last argument it looked at
+        size_t undo;  // size of the undo log before it
+        State state;  // state before it
+    };
+
+    struct Undo
+    {
+        int value;
+        Value previous;
+        int count; // of a counted flag, before
+    };
+
+    // A counted flag's count, as the string its value points at
+    struct Count
+    {
+        int n;
+        char digits[12];
+    };
+
+    void reparse(size_t from);
+    void tokenize(int start);
+    int lookup(const char* name, size_t len) const;
+    bool isOption(const char* arg) const;
+    void assign(int v, const Value& value);
+    void undoLast();
+    void setFlag(int v);
+    int cluster(const char* opt);
+    int parseStep(int i);
+
+    Cmdline& cmd;
+    std::vector<Name> names;      // sorted, pointing at the Cmdline's map keys
+    std::vector<int> positionalValues;
+    std::vector<Count> counts;    // by value, made up front so the digits never move
+
+    std::vector<char> text;       // the line as given
+    std::vector<char> tokens;     // the line with whitespace turned to nul
+    std::vector<char*> args;      // argv, pointing into tokens
+    std::vector<size_t> ends;     // end offset of each argument in text
+    std::vector<int> stepOf;      // the step each argument belongs to
+    std::vector<Step> steps;
+    std::vector<Undo> undo;
+    State state;
+    int numReparsed;
+};
+
+} // namespace cmdline
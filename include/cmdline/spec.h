@@ -0,0 +1,101 @@
+//=================================================================================================
+// spec.h
+//  - spec parser interface, for containers other than Cmdline
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+namespace cmdline
+{
+namespace internal
+{
+
+// The spec parser reports what it finds to a SpecSink, which decides how to store it.
+// Cmdline stores into std containers; FixedCmdline stores into fixed arrays. Names are
+// Fragments pointing into the spec text.
+class SpecSink
+{
+public:
+    virtual ~SpecSink() {}
+
+    // Create a new value and return its index, or -1 if it can't be stored. Named values
+    // start out as "False", positional values start out null.
+    virtual int value(bool named) = 0;
+
+    // Record a positional argument or a named option, bound to a value from value().
+    // Synonyms are reported as further names bound to the same value. minArgs and
+    // maxArgs are the range of arguments the value consumes (Value::Many for no upper
+    // limit); a named option with maxArgs of 0 doesn't change what a synonym set.
+    virtual bool positional(Fragment name, int value, int minArgs, int maxArgs) = 0;
+    virtual bool named(Fragment name, int value, int minArgs, int maxArgs) = 0;
+
+    // A usage section, from 'usage:' up to a blank line. Sinks that don't match usage
+    // patterns can ignore it.
+    virtual bool usage(Fragment section) { (void) section; return true; }
+
+    // An annotation like (requires: --bare) in the help text after a declaration, with
+    // the value it belongs to. Sinks ignore the keys they don't know.
+    virtual bool annotation(int value, Fragment key, Fragment body) { (void) value; (void) key; (void) body; return true; }
+
+    // The type of a value declared as <name:type>, with the name of the option or
+    // positional it was declared for. Sinks that don't convert values can ignore it.
+    virtual bool typed(int value, Fragment name, Fragment type) { (void) value; (void) name; (void) type; return true; }
+
+    // A named option that takes <key=value> pairs, and whether it keeps every value for
+    // a key (declared <key=value:@>) or only the last
+    virtual bool keyValue(int value, bool list) { (void) value; (void) list; return true; }
+};
+
+// Parse the spec in [text, textEnd), reporting to sink. Returns false on a syntax error
+// or if the sink refused something.
+bool study(const char* text, const char* textEnd, SpecSink& sink);
+
+// The same, but with the spec split into as many as threads chunks that are parsed
+// concurrently. The sink gets exactly the calls that study() would make, in the same
+// order, from the calling thread. Cmdline uses this for specs of several chunks.
+bool studyParallel(const char* text, const char* textEnd, SpecSink& sink, int threads);
+const int ParallelChunkBytes = 256 * 1024;
+
+// Usage patterns (see usage.cpp). compileUsage adds a usage section to usage, linkUsage
+// resolves its names against the studied spec (returning false if one isn't declared),
+// and matchUsage matches positional arguments, returning the matched line and the slot
+// each argument went to. program is argv[0], for the words that name the program.
+bool compileUsage(Fragment section, Usage& usage);
+bool linkUsage(Cmdline& cmd);
+int matchUsage(const Usage& usage, const char* program, const std::vector<const char*>& args, std::vector<int>& slots);
+
+// Constraints (see constraints.cpp). linkConstraints compiles the declared constraints
+// into masks once the spec is studied, and checkConstraints tests them after eval().
+bool linkConstraints(Cmdline& cmd);
+bool checkConstraints(Cmdline& cmd);
+
+// Typed values (see types.cpp). linkTypes lays out the arena for the converted values
+// once the spec is studied, and convertTypes fills it after eval(); convertType does
+// one slot, for lazy evaluation.
+void linkTypes(Cmdline& cmd);
+bool convertTypes(Cmdline& cmd);
+bool convertType(Cmdline& cmd, Types::Slot& slot);
+
+// Pairs for <key=value> options (see keyvalue.cpp). eval() adds the arguments of each
+// occurrence as it goes, and sorts the tables at the end.
+bool addKeyValues(Cmdline& cmd, int value, const char* option, const char* first, const char* const* rest, int n, int arg);
+void sortKeyValues(Cmdline& cmd);
+
+// Actions (see actions.cpp). addAction records an (action: ...) annotation, linkActions
+// checks them against the options' arities and copies out the constants once the spec
+// is studied, and finishActions gives counted and appended options their values at the
+// end of eval(). flagValue is what a flag reads as when it's given once, for implied
+// flags and for Session.
+bool addAction(Cmdline& cmd, int value, Fragment body);
+bool linkActions(Cmdline& cmd);
+void finishActions(Cmdline& cmd);
+const char* flagValue(const Cmdline& cmd, int value);
+
+// Declaration-ordered results (see dump.cpp). resetResults names each value the first
+// time, or when the values have changed, and clears the argv indices for eval() to fill.
+void resetResults(Cmdline& cmd);
+
+} // namespace internal
+} // namespace cmdline
@@ -0,0 +1,60 @@
+//=================================================================================================
+// specfile.h
+//  - specs read from files, mapped rather than copied
+//=================================================================================================
+
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+
+namespace cmdline
+{
+
+// A SpecFile is the text of a spec kept in a file rather than compiled in, so that a
+// deployed program's options can change without rebuilding it:
+//
+//    auto file = cmdline::SpecFile::open("/etc/tool/options.spec");
+//    cmdline::Cmdline cmd(file);
+//    cmd.eval(argc, argv);
+//
+// Regular files are mapped read-only, so studying one doesn't copy it; anything else
+// (or any file on Windows) is read into a buffer. The text is not nul-terminated, and
+// the parser stops at end(). Parsers studied from it share it, and it's unmapped when
+// the last one goes away.
+//
+// A mapping sees changes made to the file, and a studied parser holds views into it, so
+// replace a mapped spec file by writing a new one and renaming it over the old, rather
+// than by editing it in place (which changes what parsers read, and a truncation makes
+// them fault). A file that may be rewritten in place should be read() instead.
+class SpecFile
+{
+public:
+    // Returns null if the file can't be opened or read
+    static std::shared_ptr<const SpecFile> open(const char* path);
+
+    // The same, but always read into a buffer of its own, so that later changes to the
+    // file don't reach anything studied from it. SpecWatcher reads files this way.
+    static std::shared_ptr<const SpecFile> read(const char* path);
+
+    SpecFile(const SpecFile&) = delete;
+    SpecFile& operator=(const SpecFile&) = delete;
+
+    const char* begin() const { return text; }
+    const char* end() const { return text + len; }
+    size_t size() const { return len; }
+
+    // True if the text is mapped from the file rather than read
+    bool mapped() const { return isMapped; }
+
+private:
+    SpecFile(const char* text, size_t len, std::shared_ptr<const void> keep, bool isMapped);
+    static std::shared_ptr<const SpecFile> load(const char* path, bool map);
+
+    const char* text;
+    size_t len;
+    std::shared_ptr<const void> keep; // the mapping or buffer text is in
+    bool isMapped;
+};
+
+} // namespace cmdline
@@ -0,0 +1,88 @@
+//=================================================================================================
+// stream.h
+//  - stream arguments from a file descriptor, xargs -0 style
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/cmdline.h"
+
+#include <stddef.h>
+#include <memory>
+
+namespace cmdline
+{
+
+// An ArgStream reads delimited arguments from a file descriptor through a fixed-size
+// buffer, so the whole list is never in memory at once. Use '\0' as the delimiter for
+// `find -print0` style input, or '\n' for one argument per line.
+//
+// Each argument returned by next() is nul-terminated and stays valid until the next
+// call. An argument longer than the buffer is an error rather than a reallocation.
+class ArgStream
+{
+public:
+    ArgStream(int fd, char delim = '\0', size_t bufferSize = 64 * 1024);
+
+    ArgStream(const ArgStream&) = delete;
+    ArgStream& operator=(const ArgStream&) = delete;
+
+    // The next argument, or nullptr at the end of input or on an error
+    const char* next();
+
+    // Call fn(const char*) for each remaining argument, and return how many there were
+    template<typename F>
+    size_t forEach(F fn)
+    {
+        size_t n = 0;
+        while (const char* arg = next())
+        {
+            fn(arg);
+            n += 1;
+        }
+        return n;
+    }
+
+    // True if reading failed, or an argument didn't fit in the buffer
+    bool failed() const { return err; }
+
+private:
+    bool fill();
+
+    int fd;
+    char delim;
+    std::unique_ptr<char[]> buf;
+    size_t cap;
+    size_t begin; // start of unconsumed data
+    size_t end;   // end of data read so far
+    bool eof;
+    bool err;
+};
+
+// Stream the arguments for a value. If the value is "-", the arguments are read from
+// stdin; otherwise the value itself is the only argument. This lets a positional like
+// <file> accept either a path or "-" for a stream of paths. Returns the number of
+// arguments, and sets ok to false if the stream failed.
+template<typename F>
+size_t streamArgs(const Value& value, char delim, F fn, bool* ok = nullptr)
+{
+    if (ok != nullptr)
+        *ok = true;
+    if (!value.exists())
+        return 0;
+
+    const char* s = value.string();
+    if (s[0] != '-' || s[1] != '\0')
+    {
+        fn(s);
+        return 1;
+    }
+
+    ArgStream in(0, delim);
+    size_t n = in.forEach(fn);
+    if (ok != nullptr)
+        *ok = !in.failed();
+    return n;
+}
+
+} // namespace cmdline
@@ -0,0 +1,91 @@
+//=================================================================================================
+// types.h
+//  - converters for typed option values
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/bind.h"
+#include "cmdline/cmdline.h"
+
+#include <string>
+#include <vector>
+
+namespace cmdline
+{
+
+// A value can be declared with a type, as in <n:int>, and converted when the command
+// line is evaluated rather than wherever it's used. Converters map type names to
+// functions from a string to a value:
+//
+//    struct Duration { long long ms; };
+//    bool parseDuration(const char* str, Duration& out);
+//
+//    cmdline::Converters types;
+//    types.add<Duration>("duration", parseDuration);
+//    types.add<uint64_t>("bytes", [](const char* str, uint64_t& out) { ... });
+//
+//    char spec[] = "    --timeout <t:duration>    how long to wait (default: 30s)\n";
+//    cmdline::Cmdline cmd(spec, types);
+//    cmd.eval(argc, argv);
+//    const Duration* timeout = cmd.typed<Duration>("timeout");
+//
+// The built-in types are str (const char*), int, long (long long), double and bool,
+// using the converters in bind.h; a flag can be typed with a nameless value, as in
+// <:bool>. A value that doesn't convert is a command-line error, reported by eval().
+// Declaring a type that isn't known is a spec error. A value that takes several
+// arguments converts its first.
+//
+// Each type name is kept once, and a spec's type names are resolved while it's
+// studied, so the cost of a lookup is paid once per declaration rather than per eval.
+//
+// A type name ending in ',' is a list. int, and long, are built in: the argument is a
+// comma-separated list of integers and ranges, as in <shards:int,> with an argument of
+// 0-1023,2048-4095, and it converts to a std::vector<int> (or std::vector<long long>)
+// with the ranges expanded. A list that doesn't parse is reported with the byte offset
+// of the problem.
+// Parse a list of integers and ranges, as described above, into out. Returns false if
+// str isn't one, with bad set to where the problem is. An empty string is an empty
+// list. A range can have at most ListRangeLimit elements, so that a typo doesn't run
+// the process out of memory.
+bool parseList(const char* str, std::vector<int>& out, const char** bad);
+bool parseList(const char* str, std::vector<long long>& out, const char** bad);
+const long long ListRangeLimit = 1 << 24;
+
+class Converters
+{
+public:
+    // A set with the built-in types
+    Converters();
+
+    // The built-in types, for parsers that aren't given a set
+    static const Converters& builtin();
+
+    // Add a type, or replace the converter for it. f is called as f(str, out), where out
+    // is a default-constructed T, and returns false if str isn't a T.
+    template<typename T, typename F> void add(const char* name, F f)
+    {
+        insert(name, internal::Converter::make<T>(f));
+    }
+
+    // Add a type that has a converter in bind.h
+    template<typename T> void add(const char* name)
+    {
+        add<T>(name, static_cast<bool (*)(const char*, T&)>(convert));
+    }
+
+    // The converter for a type name, or null
+    const internal::Converter* find(const char* b, const char* e) const;
+
+private:
+    void insert(const char* name, const internal::Converter& converter);
+
+    struct Entry
+    {
+        std::string name;
+        internal::Converter converter;
+    };
+    std::vector<Entry> entries; // sorted by name
+};
+
+} // namespace cmdline
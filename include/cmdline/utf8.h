@@ -0,0 +1,27 @@
+//=================================================================================================
+// utf8.h
+//  - UTF-8 validation and case folding for specs and argv
+//=================================================================================================
+
+#pragma once
+
+#include <stddef.h>
+
+namespace cmdline
+{
+
+// Check that [b, e) is well-formed UTF-8: no stray continuation bytes, overlong forms,
+// surrogates or code points past U+10FFFF. Runs of ASCII are skipped 16 bytes at a time
+// with SSE2 where it's available, and 8 at a time otherwise, so ASCII input costs about
+// as much as strlen. On failure, bad (if given) is set to the first invalid byte.
+bool validUtf8(const char* b, const char* e, const char** bad = nullptr);
+
+// The number of code points in [b, e), which must be valid UTF-8
+size_t utf8Length(const char* b, const char* e);
+
+// Fold the case of [b, e) in place. This is simple case folding for ASCII, Latin-1,
+// Greek and Cyrillic capitals, all of which fold to a lowercase letter of the same
+// encoded length; anything else is left alone.
+void foldCase(char* b, char* e);
+
+} // namespace cmdline
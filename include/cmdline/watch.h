@@ -0,0 +1,82 @@
+//=================================================================================================
+// watch.h
+//  - hot reloading of spec files for long-running programs
+//=================================================================================================
+
+#pragma once
+
+#include "cmdline/group.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cmdline
+{
+
+// A SpecWatcher keeps a spec file studied as an OptionGroup, and studies it again when
+// the file changes, so a daemon can pick up a new option surface without a restart:
+//
+//    cmdline::SpecWatcher options("/etc/tool/options.spec");
+//
+//    // for each request
+//    char none[] = "";
+//    cmdline::Cmdline cmd(none);
+//    cmd.include(options.current());
+//    cmd.eval(argc, argv);
+//
+// A new group replaces the old one with an atomic pointer swap. A reader holds the
+// group it got from current() for as long as it needs it, so it never sees a group
+// change underneath it, and an old group (and the copy of the file it was studied
+// from) goes away with its last reader. If the new file can't be read or doesn't
+// study, the old group stays, and error() says why.
+//
+// The file is read into memory each time rather than mapped, so it can be rewritten in
+// place as well as replaced by renaming a new file over it. On Linux a background
+// thread watches the file's directory with inotify, which sees both. Elsewhere, call
+// reload() when the file is known to have changed (on SIGHUP, say).
+class SpecWatcher
+{
+public:
+    explicit SpecWatcher(const char* path, int flags = 0);
+    ~SpecWatcher();
+
+    SpecWatcher(const SpecWatcher&) = delete;
+    SpecWatcher& operator=(const SpecWatcher&) = delete;
+
+    // The latest group that studied cleanly. It's only null if the file has never
+    // studied.
+    std::shared_ptr<const OptionGroup> current() const { return std::atomic_load(&group); }
+
+    // Study the file again now. Returns false, keeping the current group, if it can't
+    // be read or doesn't study.
+    bool reload();
+
+    // How many times a new group has been swapped in
+    int generation() const { return numSwaps.load(); }
+
+    // Why the last reload failed, or an empty string if it didn't
+    std::string error() const;
+
+    // True if changes are picked up without calling reload()
+    bool watching() const { return thread.joinable(); }
+
+private:
+    void watch();
+
+    std::string path;
+    int flags;
+    std::shared_ptr<const OptionGroup> group; // only touched with atomic_load/store
+    std::atomic<int> numSwaps;
+
+    mutable std::mutex mutex; // serializes reloads, and guards lastError
+    std::string lastError;
+
+    int notifyFd;
+    int wakeFds[2]; // written to by the destructor to stop the thread
+    std::thread thread;
+};
+
+} // namespace cmdline
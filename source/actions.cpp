@@ -0,0 +1,194 @@
+//=================================================================================================
+// actions.cpp
+//  - argparse-style actions: counting, constants and appending
+//=================================================================================================
+
+#include "cmdline/cmdline.h"
+#include "cmdline/spec.h"
+#include "cmdline/utf8.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace cmdline
+{
+
+// Actions are written in the help text of a declaration, with a constant after the
+// name for the two that take one:
+//
+//  -v, --verbose          more output; give it again for more (action: count)
+//  -q, --quiet            (action: store_false)
+//  -O, --optimize         build for speed (action: store_const fast)
+//  -t, --tag <tag>        tag the build; can be repeated (action: append)
+//  --release              (action: append_const release)
+//
+// store and store_true are what options and flags do anyway, so declaring them only
+// checks the arity. eval() switches on the code for each option it sees: flags with
+// store_false or a constant point their value at a string that already exists, count
+// bumps a counter, and append adds each argument to a list that's gathered into one
+// run at the end, so a repeated option keeps every argument it was given.
+
+namespace
+{
+const struct { const char* name; internal::Actions::Code code; } names[] = {
+    { "store", internal::Actions::Store },
+    { "store_true", internal::Actions::StoreTrue },
+    { "store_false", internal::Actions::StoreFalse },
+    { "store_const", internal::Actions::StoreConst },
+    { "append", internal::Actions::Append },
+    { "append_const", internal::Actions::AppendConst },
+    { "count", internal::Actions::Count },
+};
+
+const char* NameOf(internal::Actions::Code code)
+{
+    for (auto& n : names)
+        if (n.code == code)
+            return n.name;
+    return "";
+}
+
+// The name of a value, the way a user would type it, for errors
+std::string OptionName(const Cmdline& cmd, int v)
+{
+    std::string name;
+    for (auto& opt : cmd.options)
+        if (opt.second == v && opt.first.size() + 2 > name.size())
+            name = (utf8Length(opt.first.data(), opt.first.data() + opt.first.size()) == 1 ? "-" : "--") + opt.first;
+    return name;
+}
+}
+
+bool internal::addAction(Cmdline& cmd, int v, Fragment body)
+{
+    const char* e = body.b;
+    while (e < body.e && *e != ' ' && *e != '\t')
+        e++;
+    const char* constant = e;
+    while (constant < body.e && (*constant == ' ' || *constant == '\t'))
+        constant++;
+
+    for (auto& n : names)
+    {
+        if (strlen(n.name) != (size_t) (e - body.b) || strncmp(n.name, body.b, e - body.b) != 0)
+            continue;
+        if (!cmd.actions)
+            cmd.actions.reset(new Actions);
+        Actions& a = *cmd.actions;
+        if ((int) a.codes.size() <= v)
+        {
+            a.codes.resize(v + 1, Actions::Store);
+            a.slotOf.resize(v + 1, -1);
+        }
+        if (a.slotOf[v] >= 0)
+        {
+            cmd.errorMsg += "more than one action for " + OptionName(cmd, v) + "\n";
+            return false;
+        }
+        a.codes[v] = n.code;
+        a.slotOf[v] = (int) a.slots.size();
+        a.slots.push_back(Actions::Slot{ v, n.code, Fragment(constant, body.e), nullptr, 0, {} });
+        return true;
+    }
+
+    cmd.errorMsg += "unknown action in spec: " + std::string(body.b, e) + "\n";
+    return false;
+}
+
+// Every action but store and append is for flags. The constants are copied into one
+// block, nul-terminated.
+bool internal::linkActions(Cmdline& cmd)
+{
+    Actions& a = *cmd.actions;
+    a.codes.resize(cmd.values.size(), Actions::Store);
+    a.slotOf.resize(cmd.values.size(), -1);
+
+    bool ok = true;
+    size_t size = 0;
+    for (auto& slot : a.slots)
+    {
+        bool flag = slot.code != Actions::Store && slot.code != Actions::Append;
+        bool hasConstant = slot.code == Actions::StoreConst || slot.code == Actions::AppendConst;
+        const Value& value = cmd.values[slot.value];
+        const char* problem = nullptr;
+        if (flag && value.maxArgs() != 0)
+            problem = " is for options without arguments: ";
+        else if (!flag && value.maxArgs() == 0)
+            problem = " is for options with arguments: ";
+        else if (hasConstant && slot.text.b == slot.text.e)
+            problem = " needs a constant: ";
+        if (problem != nullptr)
+        {
+            cmd.errorMsg += std::string("action ") + NameOf(slot.code) + problem + OptionName(cmd, slot.value) + "\n";
+            ok = false;
+        }
+        if (hasConstant)
+            size += slot.text.e - slot.text.b + 1;
+    }
+
+    a.pool.reset(new char[size + 1]);
+    char* p = a.pool.get();
+    for (auto& slot : a.slots)
+    {
+        if (slot.code == Actions::StoreFalse)
+        {
+            // Not given, it reads as true
+            Value initial("True", false);
+            initial.arity(0, 0);
+            cmd.values[slot.value] = initial;
+        }
+        if (slot.code != Actions::StoreConst && slot.code != Actions::AppendConst)
+            continue;
+        size_t n = slot.text.e - slot.text.b;
+        memcpy(p, slot.text.b, n);
+        p[n] = '\0';
+        slot.constant = p;
+        p += n + 1;
+    }
+    return ok;
+}
+
+const char* internal::flagValue(const Cmdline& cmd, int v)
+{
+    Actions::Code code = cmd.actions ? cmd.actions->code(v) : Actions::Store;
+    switch (code)
+    {
+    case Actions::StoreFalse: return "False";
+    case Actions::StoreConst:
+    case Actions::AppendConst: return cmd.actions->slots[cmd.actions->slotOf[v]].constant;
+    case Actions::Count: return "1";
+    default: return "True";
+    }
+}
+
+// Counted flags get their count, as a string, and appended options get every argument
+// they collected, in argv order
+void internal::finishActions(Cmdline& cmd)
+{
+    Actions& a = *cmd.actions;
+    a.appended.clear();
+    a.appended.reserve(a.items.size());
+    for (int s = 0; s < (int) a.slots.size(); s++)
+    {
+        Actions::Slot& slot = a.slots[s];
+        if (slot.code == Actions::Count && slot.count > 0)
+        {
+            snprintf(slot.digits, sizeof(slot.digits), "%d", slot.count);
+            cmd.values[slot.value].set(slot.digits);
+            slot.count = 0;
+        }
+        if ((slot.code != Actions::Append && slot.code != Actions::AppendConst) || a.items.empty())
+            continue;
+
+        size_t start = a.appended.size();
+        for (auto& item : a.items)
+            if (item.slot == s)
+                a.appended.push_back(item.str);
+        int n = (int) (a.appended.size() - start);
+        if (n > 0)
+            cmd.values[slot.value].set(a.appended[start], a.appended.data() + start + 1, n);
+    }
+    a.items.clear();
+}
+
+} // namespace cmdline
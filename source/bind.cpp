@@ -0,0 +1,71 @@
+//=================================================================================================
+// bind.cpp
+//  - converters for bound options
+//=================================================================================================
+
+#include "cmdline/bind.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace cmdline
+{
+
+bool convert(const char* str, const char*& out)
+{
+    out = str;
+    return true;
+}
+
+bool convert(const char* str, std::string& out)
+{
+    out = str;
+    return true;
+}
+
+// Booleans are what eval() stores for flags ("True"), plus the usual spellings
+bool convert(const char* str, bool& out)
+{
+    static const char* yes[] = { "True", "true", "1", "yes", "on" };
+    static const char* no[] = { "False", "false", "0", "no", "off" };
+    for (auto s : yes)
+        if (strcmp(str, s) == 0) { out = true; return true; }
+    for (auto s : no)
+        if (strcmp(str, s) == 0) { out = false; return true; }
+    return false;
+}
+
+bool convert(const char* str, int& out)
+{
+    long long n;
+    if (!convert(str, n) || n < INT_MIN || n > INT_MAX)
+        return false;
+    out = (int) n;
+    return true;
+}
+
+bool convert(const char* str, long long& out)
+{
+    char* end;
+    errno = 0;
+    long long n = strtoll(str, &end, 0);
+    if (end == str || *end != '\0' || errno == ERANGE)
+        return false;
+    out = n;
+    return true;
+}
+
+bool convert(const char* str, double& out)
+{
+    char* end;
+    errno = 0;
+    double d = strtod(str, &end);
+    if (end == str || *end != '\0' || errno == ERANGE)
+        return false;
+    out = d;
+    return true;
+}
+
+} // namespace cmdline
@@ -4,20 +4,45 @@
 //=================================================================================================
 
 #include "cmdline/cmdline.h"
+#include "cmdline/spec.h"
+#include "cmdline/specfile.h"
+#include "cmdline/types.h"
+#include "cmdline/utf8.h"
 
 #include <string.h>
-#include <sstream>
+#include <algorithm>
 #include <string>
+#include <thread>
 
 namespace cmdline
 {
 
 // Parse a command line instance according to the spec
-Cmdline::Cmdline(int argc, char** argv, char* spec_) : spec(spec_)
+Cmdline::Cmdline(int argc, char** argv, char* spec_, int flags) : Cmdline(spec_, flags)
 {
-    int len = strlen(spec);
-    specEnd = spec + len;
+    if (flags & Lazy)
+        index(argc, argv);
+    else
+        eval(argc, argv);
+}
+
+// Study the spec, leaving the command line to a later eval()
+Cmdline::Cmdline(char* spec_, int flags) : Cmdline(spec_, spec_ + strlen(spec_), flags)
+{
+}
+
+Cmdline::Cmdline(char* spec_, char* specEnd_, int flags) : Cmdline(spec_, specEnd_, nullptr, flags)
+{
+}
 
+Cmdline::Cmdline(char* spec_, const Converters& types_, int flags) : Cmdline(spec_, spec_ + strlen(spec_), &types_, flags)
+{
+}
+
+Cmdline::Cmdline(char* spec_, char* specEnd_, const Converters* types_, int flags)
+    : spec(spec_), specEnd(specEnd_), failed(false), badArgs(false), foldCase((flags & FoldCase) != 0),
+      errorLength(std::string::npos), matchedLine(-1)
+{
     // Skip leading newlines as being artifacts of how embedded
     // specs are supplied (typically with R"raw(...)raw" strings)
     while ((spec < specEnd && spec[0] == '\n')
@@ -26,20 +51,107 @@ Cmdline::Cmdline(int argc, char** argv, char* spec_) : spec(spec_)
         spec += 1;
 
     // For now, the entire spec is also the help message
-    usageMsg = std::string(spec);
+    usageMsg = std::string(spec, specEnd);
 
-    // Parse the spec and assign values to parameters
-    study();
-    eval(argc, argv);
+    // Parse the spec; values are assigned to parameters by eval
+    study(types_ != nullptr ? *types_ : Converters::builtin());
 }
 
-Cmdline::~Cmdline()
+namespace
 {
-    for (auto v : values)
-        delete v;
+char noSpec[] = "";
 }
 
-const std::string& Cmdline::usage()
+// The file is kept for as long as anything studied from it is, since the option names
+// and help text are views into it
+Cmdline::Cmdline(std::shared_ptr<const SpecFile> file, int flags)
+    : Cmdline(file ? const_cast<char*>(file->begin()) : noSpec, file ? const_cast<char*>(file->end()) : noSpec, flags)
+{
+    if (!file)
+    {
+        failed = true;
+        errorMsg += "spec file could not be read\n";
+    }
+    specFile = std::move(file);
+}
+
+// Heap bytes held by the containers. The per-node overhead of std::map is a guess
+// (three pointers and a color), and strings only cost heap when they outgrow their
+// small-string buffer, so this is an estimate rather than an exact count.
+size_t Cmdline::footprint() const
+{
+    const size_t mapNode = sizeof(std::map<std::string, int, NameLess>::value_type) + 4 * sizeof(void*);
+    const size_t sso = std::string().capacity();
+    auto heap = [sso](const std::string& s) { return s.capacity() > sso ? s.capacity() + 1 : 0; };
+
+    size_t bytes = usageMsg.capacity() + 1 + errorMsg.capacity() + 1;
+    for (auto& opt : options)
+        bytes += mapNode + heap(opt.first);
+    bytes += (values.capacity() + initial.capacity()) * sizeof(Value);
+    bytes += positionals.capacity() * sizeof(std::string);
+    for (auto& pos : positionals)
+        bytes += heap(pos);
+    bytes += argv_parts.capacity() * sizeof(Fragment);
+    bytes += gathered.capacity() * sizeof(const char*);
+    bytes += bound.capacity() * sizeof(Bound);
+    bytes += handlers.capacity() * sizeof(Handlers);
+    bytes += keyValueTables.capacity() * sizeof(KeyValues);
+    bytes += parsed.capacity() * sizeof(Parsed);
+    if (actions)
+        bytes += sizeof(internal::Actions) + actions->codes.capacity() + actions->slotOf.capacity() * sizeof(int)
+            + actions->slots.capacity() * sizeof(internal::Actions::Slot) + actions->items.capacity() * sizeof(internal::Actions::Item)
+            + actions->appended.capacity() * sizeof(const char*);
+    if (lazy)
+        bytes += sizeof(internal::Lazy) + lazy->tokens.capacity() * sizeof(internal::Lazy::Token)
+            + lazy->resolved.capacity() + lazy->positional.capacity();
+    if (scratch)
+        bytes += sizeof(internal::Scratch) + (scratch->args.capacity() + scratch->used.capacity()) * sizeof(int)
+            + scratch->placed.capacity() * sizeof(internal::Scratch::Placed) + scratch->split.capacity() * sizeof(char*)
+            + scratch->owner.capacity() * sizeof(int) + scratch->clustered.capacity() * sizeof(internal::Scratch::Clustered);
+    for (auto& table : keyValueTables)
+        bytes += table.pairs.capacity() * sizeof(KeyValues::Pair);
+    if (constraints)
+    {
+        auto& c = *constraints;
+        bytes += sizeof(internal::Constraints) + c.declared.capacity() * sizeof(c.declared[0]) + c.rowOf.capacity() * sizeof(int);
+        bytes += (c.conflicts.capacity() + c.required.capacity() + c.implies.capacity()
+            + c.constrained.capacity() + c.seen.capacity()) * sizeof(uint64_t);
+        bytes += c.names.capacity() * sizeof(std::string);
+        for (auto& d : c.declared)
+            bytes += heap(d.names);
+        for (auto& name : c.names)
+            bytes += heap(name);
+    }
+    if (defaults)
+    {
+        bytes += sizeof(internal::Defaults) + defaults->entries.capacity() * sizeof(internal::Defaults::Entry);
+        for (auto& entry : defaults->entries)
+            bytes += entry.str ? entry.text.e - entry.text.b + 1 : 0;
+    }
+    if (types)
+    {
+        auto& t = *types;
+        bytes += sizeof(internal::Types) + t.slots.capacity() * sizeof(t.slots[0]) + t.slotOf.capacity() * sizeof(int);
+        if (!t.slots.empty())
+            bytes += t.slots.back().offset + t.slots.back().converter.size;
+    }
+    return bytes;
+}
+
+std::string Cmdline::key(const char* b, const char* e) const
+{
+    std::string k(b, e);
+    if (foldCase && !k.empty())
+        cmdline::foldCase(&k[0], &k[0] + k.size());
+    return k;
+}
+
+std::string Cmdline::key(const char* name) const
+{
+    return key(name, name + strlen(name));
+}
+
+const std::string& Cmdline::usage() const
 {
     return usageMsg;
 }
@@ -47,144 +159,626 @@ const std::string& Cmdline::usage()
 // Find a parameter and return its value. All declared parameters are
 // in the parsed object, but parameters not supplied on the command-line
 // have null values
-const cmdline::Value& cmdline::Cmdline::operator[](const char* option)
+const cmdline::Value& cmdline::Cmdline::operator[](const char* option) const
 {
-	auto pos = options.find(option);
+	int v = lookup(option);
 
     // If we don't find it, it's actually a syntax error by the caller, so
     // we should do something in debug like throw or assert.
-	if (pos == options.end())
+	if (v < 0)
 		return noValue;
+    if (lazy)
+        resolve(v);
+
+    const Value& value = values[v];
+    internal::Defaults::Entry* entry;
+    if (!value.exists() && defaults && (entry = defaults->find(v)) != nullptr)
+        return defaults->materialize(*entry, value);
+    return value;
+}
 
-	return *(pos->second);
+// Copy a default out of the spec, the first time it's needed
+const Value& internal::Defaults::materialize(Entry& entry, const Value& declared)
+{
+    if (!entry.str)
+    {
+        size_t n = entry.text.e - entry.text.b;
+        entry.str.reset(new char[n + 1]);
+        memcpy(entry.str.get(), entry.text.b, n);
+        entry.str[n] = '\0';
+        entry.value = Value(entry.str.get(), false);
+        entry.value.arity(declared.nargs(), declared.maxArgs());
+    }
+    return entry.value;
 }
 
 //=================================================================================================
 
-// Construct state string
-const std::string cmdline::Cmdline::state()
+bool Cmdline::on(const char* option, Handler handler, bool store)
 {
-    std::stringstream buf;
+    int v = lookup(option);
+    if (v < 0)
+        return false;
 
-    // argv parts
-    buf << "Argv substrings: (" << argv_parts.size() << ")\n";
-    for (auto& parts : argv_parts)
-        buf << "    " << parts << "\n";
+    if (handlers.size() < values.size())
+        handlers.resize(values.size());
+    handlers[v].handler = std::move(handler);
+    handlers[v].store = store;
+    return true;
+}
 
-    // positionals
-    buf << "Positional arguments: (" << positionals.size() << ")\n";
-    for (auto& pos : positionals)
-        buf << "    " << pos << "\n";
+void Cmdline::onAny(Handler handler)
+{
+    anyHandler = std::move(handler);
+}
 
-    // options
-    int used = 0;
-    for (auto& opt : options)
-        if (opt.second->exists())
-            used += 1;
+namespace
+{
+// Hand a recognized value to its handlers. Returns false if the handlers asked for
+// the value not to be stored.
+bool Notify(Cmdline& cmd, const std::string& name, int v, const char* str, int arg, bool positional)
+{
+    bool store = true;
+    if (cmd.anyHandler || v < (int) cmd.handlers.size())
+    {
+        Event event{ name.c_str(), str, v, arg, positional };
+        if (cmd.anyHandler)
+            cmd.anyHandler(event);
+        if (v < (int) cmd.handlers.size())
+        {
+            auto& h = cmd.handlers[v];
+            if (h.handler)
+                h.handler(event);
+            store = h.store;
+        }
+    }
+    return store;
+}
 
-    buf << "Options used: (" << used << ")\n";
-    for (auto& opt : options)
-        if (opt.second->exists())
-            buf << "    " << opt.first << ": " << opt.second->print() << "\n";
+// Is this argument a recognized option, or "--"? This is what stops an option that
+// takes a range of values from swallowing the option after it.
+bool IsOption(const Cmdline& cmd, const char* arg)
+{
+    if (arg[0] != '-' || arg[1] == '\0')
+        return false;
 
-    buf << "Options not used: (" << (options.size() - used) << ")\n";
-    for (auto& opt : options)
-        if (!opt.second->exists())
-            buf << "    " << opt.first << ": " << opt.second->print() << "\n";
+    const char* opt = arg + 1;
+    if (*opt == '-') opt++;
+    if (*opt == '\0')
+        return true; // "--"
 
-    std::string rval = buf.str();
-    return rval;
+    const char* eq = strchr(opt, '=');
+    size_t len = eq != nullptr ? eq - opt : strlen(opt);
+    return cmd.lookup(opt, opt + len) >= 0;
 }
 
-//=================================================================================================
+typedef internal::Scratch::Placed Placed;
 
-const std::string cmdline::Value::print()
+// Apply a flag's action. A flag is set to "True" unless it's declared otherwise; the
+// other flag actions point it at a constant, or count or collect it for the end of
+// eval().
+void ApplyFlag(Cmdline& cmd, const std::string& name, int v, int arg)
 {
-    std::stringstream buf;
+    typedef internal::Actions Actions;
+    Actions::Code code = cmd.actions ? cmd.actions->code(v) : Actions::Store;
+    const char* str = "True";
+    switch (code)
+    {
+    case Actions::StoreFalse: str = "False"; break;
+    case Actions::StoreConst:
+    case Actions::AppendConst: str = cmd.actions->slot(v).constant; break;
+    default: break;
+    }
+    if (!Notify(cmd, name, v, str, arg, false))
+        return;
+
+    switch (code)
+    {
+    case Actions::AppendConst: cmd.actions->items.push_back(Actions::Item{ cmd.actions->slotOf[v], str }); break;
+    case Actions::Count: cmd.actions->slot(v).count += 1; break;
+    default: cmd.values[v].set(str); break;
+    }
+    cmd.parsed[v].arg = arg;
+}
 
-    buf << "{ exist: " << (valid ? "true" : "false");
-    buf << ", nargs: " << num_args;
-    buf << ", str: " << (str == nullptr ? "<null>" : str) << "}";
+// Split a cluster of short options, like -vvv or -xzf, into one option per code point.
+// Every one but the last has to be a flag, and those are applied and marked used here;
+// the last is returned for eval() to carry on with, since it may take the arguments
+// after it. Each one is recorded for ArgvBuilder. Returns -1, having done nothing, if
+// the argument isn't a cluster.
+int Cluster(Cmdline& cmd, const char* opt, int arg, const std::string** name)
+{
+    const char* last = nullptr;
+    for (const char* p = opt; *p != '\0'; )
+    {
+        const char* e = p + 1;
+        while ((*e & 0xc0) == 0x80)
+            e++;
+        int v = cmd.lookup(p, e, name);
+        if (v < 0)
+            return -1;
+        if (*e != '\0' && cmd.values[v].maxArgs() != 0)
+            return -1;
+        last = p;
+        p = e;
+    }
+    if (last == nullptr || last == opt)
+        return -1;
 
-    return buf.str();
+    internal::Scratch& s = *cmd.scratch;
+    for (const char* p = opt; p != last; )
+    {
+        const char* e = p + 1;
+        while ((*e & 0xc0) == 0x80)
+            e++;
+        int v = cmd.lookup(p, e, name);
+        s.used.push_back(v);
+        s.clustered.push_back(internal::Scratch::Clustered{ arg, v, p });
+        ApplyFlag(cmd, **name, v, arg);
+        p = e;
+    }
+    int v = cmd.lookup(last, last + strlen(last), name);
+    s.clustered.push_back(internal::Scratch::Clustered{ arg, v, last });
+    return v;
 }
 
-//=================================================================================================
 
-void Cmdline::eval(int argc, char** argv)
+// Positional values are stored once all of them are known, because a positional that
+// takes several arguments doesn't necessarily get a contiguous run of argv (options
+// can be mixed in). Contiguous runs point into argv; the others are copied (as
+// pointers) into one gathered array, sized up front so it never reallocates.
+void StorePositionals(Cmdline& cmd, char** argv, std::vector<Placed>& placed)
+{
+    // Without usage patterns they're placed in declaration order already, and skipping
+    // the sort saves stable_sort's temporary buffer
+    auto byValue = [](const Placed& a, const Placed& b) { return a.value < b.value; };
+    if (!std::is_sorted(placed.begin(), placed.end(), byValue))
+        std::stable_sort(placed.begin(), placed.end(), byValue);
+
+    cmd.gathered.clear();
+    cmd.gathered.reserve(placed.size());
+
+    for (size_t b = 0; b < placed.size(); )
+    {
+        size_t e = b + 1;
+        bool contiguous = true;
+        for (; e < placed.size() && placed[e].value == placed[b].value; e++)
+            if (placed[e].arg != placed[e - 1].arg + 1)
+                contiguous = false;
+
+        int n = (int) (e - b);
+        Value& value = cmd.values[placed[b].value];
+        cmd.parsed[placed[b].value].arg = placed[b].arg;
+        if (contiguous)
+            value.set(argv[placed[b].arg], &argv[placed[b].arg + 1], n);
+        else
+        {
+            size_t start = cmd.gathered.size();
+            for (size_t k = b; k < e; k++)
+                cmd.gathered.push_back(argv[placed[k].arg]);
+            value.set(cmd.gathered[start], &cmd.gathered[start + 1], n);
+        }
+        b = e;
+    }
+}
+
+// Pick the positional for the next argument, in declaration order. A positional that
+// takes several arguments keeps taking them until it's full.
+int NextPositional(Cmdline& cmd, int& positional, int& taken)
+{
+    while (positional < (int) cmd.positionals.size())
+    {
+        int v = cmd.options.find(cmd.positionals[positional])->second;
+        int most = std::max(cmd.values[v].maxArgs(), 1);
+        if (taken < most)
+        {
+            taken += 1;
+            return v;
+        }
+        positional += 1;
+        taken = 0;
+    }
+    return -1;
+}
+
+// Assign positional arguments to positionals in the order they were declared
+bool AssignInOrder(Cmdline& cmd, char** argv, int i, int& positional, int& taken, std::vector<Placed>& placed)
+{
+    int v = NextPositional(cmd, positional, taken);
+    if (v < 0)
+    {
+        cmd.badArgs = true;
+        cmd.errorMsg += std::string("unexpected argument: ") + argv[i] + "\n";
+        return false; // this is a bad argument
+    }
+
+    if (Notify(cmd, cmd.positionals[positional], v, argv[i], i, true))
+        placed.push_back(Placed{ v, i });
+    return true;
+}
+
+// Match positional arguments against the usage patterns, and assign them to the
+// positionals they matched. Then check the options that were used against the ones
+// the matching line allows and requires.
+bool MatchUsage(Cmdline& cmd, char** argv, const std::vector<int>& args, const std::vector<int>& used,
+    std::vector<Placed>& placed)
 {
-    // Populate values into the command-line. Positional args are assigned by relative
-    // offset in the command line
+    auto& usage = *cmd.usagePatterns;
 
+    std::vector<const char*> strs;
+    for (int i : args)
+        strs.push_back(argv[i]);
+
+    std::vector<int> slots;
+    cmd.matchedLine = internal::matchUsage(usage, argv[0], strs, slots);
+    if (cmd.matchedLine < 0)
+    {
+        cmd.badArgs = true;
+        cmd.errorMsg += "arguments don't match any usage line\n";
+        return false;
+    }
+
+    for (int k = 0; k < (int) args.size(); k++)
+    {
+        if (slots[k] < 0)
+            continue; // a command word
+        int v = usage.slotValues[slots[k]];
+        if (Notify(cmd, usage.slots[slots[k]], v, argv[args[k]], args[k], true))
+            placed.push_back(Placed{ v, args[k] });
+    }
+
+    auto& line = usage.lines[cmd.matchedLine];
+    if (!line.anyOption)
+    {
+        for (int v : used)
+        {
+            if (!std::binary_search(line.allowedValues.begin(), line.allowedValues.end(), v))
+            {
+                cmd.badArgs = true;
+                cmd.errorMsg += "option not allowed by usage line\n";
+                break;
+            }
+        }
+    }
+    for (int k = 0; k < (int) line.requiredValues.size(); k++)
+    {
+        if (!cmd.values[line.requiredValues[k]].exists())
+        {
+            cmd.badArgs = true;
+            cmd.errorMsg += "missing required option: " + line.required[k] + "\n";
+        }
+    }
+    return true;
+}
+}
+
+void Cmdline::eval(int argc, char** argv)
+{
+    // Populate values into the command-line. Named options are assigned as they are
+    // seen. Positional args are either assigned by relative offset in the command line,
+    // or (if there are usage patterns) gathered up and matched against the patterns.
+    // When argv doesn't match any usage line, we still fall back to relative offsets,
+    // so that informal usage lines don't lose the positionals.
+    //
+    // This is a single pass over argv; an option taking a range of values looks ahead
+    // one argument at a time, and never rescans.
+
+    bool usePatterns = usagePatterns && !usagePatterns->empty();
+    lazy.reset();
+
+    // Forget the last eval(). The containers keep their storage, so this doesn't
+    // allocate.
+    if (errorLength == std::string::npos)
+        errorLength = errorMsg.size();
+    std::copy(initial.begin(), initial.end(), values.begin());
+    badArgs = false;
+    errorMsg.resize(errorLength);
+    argv_parts.clear();
+    matchedLine = -1;
+
+    if (!scratch)
+        scratch.reset(new internal::Scratch);
+    std::vector<int>& args = scratch->args;
+    std::vector<int>& used = scratch->used;
+    std::vector<Placed>& placed = scratch->placed;
+    std::vector<int>& owner = scratch->owner;
+    args.clear();
+    used.clear();
+    placed.clear();
+    owner.assign(argc, -1);
+    scratch->clustered.clear();
+    scratch->argc = argc;
+    scratch->argv = argv;
+    bool optionsEnded = false;
     int positional = 0;
+    int taken = 0;
+
+    // Arguments that aren't UTF-8 are reported, but still parsed, since they may be
+    // file names that the caller can deal with
+    for (int k = 1; k < argc; k++)
+    {
+        if (!validUtf8(argv[k], argv[k] + strlen(argv[k])))
+        {
+            badArgs = true;
+            errorMsg += "argument " + std::to_string(k) + " is not valid UTF-8\n";
+        }
+    }
+
+    for (auto& table : keyValueTables)
+        table.pairs.clear();
+    internal::resetResults(*this);
+
     int i = 1; // first arg is always program name
     for (; i < argc; i++)
     {
-        // If this is a positional argument, find and assign it
-        if (argv[i][0] != '-')
+        // A "--" ends the named options; everything after it is positional
+        if (!optionsEnded && strcmp(argv[i], "--") == 0)
         {
-            auto pos = options.find(positionals[positional]);
-            if (pos == options.end())
-                break; // this is a bad argument
+            optionsEnded = true;
+            continue;
+        }
 
-            pos->second->set(argv[i]);
-            positional++;
+        // If this is a positional argument, assign it or save it for matching. A lone
+        // '-' is positional too, conventionally meaning stdin.
+        if (optionsEnded || argv[i][0] != '-' || argv[i][1] == '\0')
+        {
+            if (usePatterns)
+                args.push_back(i);
+            else if (!AssignInOrder(*this, argv, i, positional, taken, placed))
+                break;
+            continue;
         }
 
         // Otherwise, it must be a named argument. This could be a --option=value
         // or --option value; only arguments that can take values allow them.
-        // TBD we don't handle --option=value yet
-        else
+        const char* opt = argv[i];
+        if (*opt == '-') opt++;
+        if (*opt == '-') opt++;
+
+        // If we find a '=' character in the argument, then split it into pieces.
+        // The value is the tail of the argument, so it is already nul-terminated;
+        // only the option name needs a copy, to look it up.
+        const char* eq = strchr(opt, '=');
+        const char* opt_val = nullptr;
+        if (eq != nullptr)
         {
-            const char* opt = argv[i];
-            if (*opt == '-') opt++;
-            if (*opt == '-') opt++;
-
-            // If we find a '=' character in the argument, then split it into pieces
-            // (and qq now we need to allocate some strings)
-            const char* eq = strchr(opt, '=');
-            const char* opt_val = nullptr;
-            if (eq != nullptr)
-            {
-                int csize = strlen(opt);
-                int argsize = eq - opt;
-                int valsize = csize - argsize - 1;
-                argv_parts.push_back(std::string(opt, argsize));
-                argv_parts.push_back(std::string(eq + 1, valsize));
-                opt = (argv_parts.end() - 2)->c_str();
-                opt_val = argv_parts.back().c_str();
-            }
+            argv_parts.push_back(Fragment(opt, eq));
+            argv_parts.push_back(Fragment(eq + 1, eq + 1 + strlen(eq + 1)));
+            opt_val = eq + 1;
+        }
 
-            auto pos = options.find(opt);
-            if (pos == options.end())
-                break; // this is a bad argument
+        const std::string* name = nullptr;
+        int v = lookup(opt, eq != nullptr ? eq : opt + strlen(opt), &name);
+        if (v < 0 && eq == nullptr && argv[i][1] != '-')
+            v = Cluster(*this, opt, i, &name);
+        if (v < 0)
+        {
+            badArgs = true;
+            errorMsg += std::string("unknown option: ") + argv[i] + "\n";
+            break; // this is a bad argument
+        }
 
-            // If this argument consumes values, then get them
-            // TBD we just handle one value at the moment
-            if (pos->second->nargs() > 0)
-            {
-                int n = pos->second->nargs();
-                for (; n > 0; n--)
-                {
-                    if (opt_val != nullptr)
-                    {
-                        pos->second->set(opt_val);
-                        continue;
-                    }
-
-                    i += 1;
-                    if (i >= argc)
-                        break; // syntax error
-                    auto val = argv[i];
-                    pos->second->set(val);
-                }
-            }
+        Value& value = values[v];
+        used.push_back(v);
+        owner[i] = v;
+
+        // If it takes no args, it's a flag
+        if (value.maxArgs() == 0)
+        {
+            ApplyFlag(*this, *name, v, i);
+            continue;
+        }
+
+        // Otherwise take values greedily, up to the most the option allows, stopping
+        // at the next option or "--". The values are a run of argv after the option,
+        // except that the first one may have come from --option=value.
+        int at = i;
+        int n = opt_val != nullptr ? 1 : 0;
+        while (n < value.maxArgs() && i + 1 < argc && !IsOption(*this, argv[i + 1]))
+        {
+            i += 1;
+            n += 1;
+            owner[i] = v;
+        }
+
+        // argv[at + 1] is only read if it was taken; argv needn't end with a null
+        const char* first = opt_val != nullptr ? opt_val : n > 0 ? argv[at + 1] : nullptr;
+        const char* const* rest = opt_val != nullptr ? &argv[at + 1] : &argv[at + 2];
+        bool store = true;
+        for (int k = 0; k < n; k++)
+        {
+            int arg = opt_val != nullptr ? at + k : at + 1 + k;
+            if (!Notify(*this, *name, v, k == 0 ? first : rest[k - 1], arg, false))
+                store = false;
+        }
+
+        if (n < value.nargs())
+        {
+            badArgs = true;
+            errorMsg += std::string("missing value for option: ") + argv[at] + "\n";
+        }
+        if (n > 0 && store && actions && actions->code(v) == internal::Actions::Append)
+        {
+            for (int k = 0; k < n; k++)
+                actions->items.push_back(internal::Actions::Item{ actions->slotOf[v], k == 0 ? first : rest[k - 1] });
+            parsed[v].arg = at;
+        }
+        else if (n > 0 && store)
+        {
+            value.set(first, rest, n);
+            parsed[v].arg = at;
+        }
+        if (n > 0 && store && !keyValueTables.empty())
+            internal::addKeyValues(*this, v, argv[at], first, rest, n, opt_val != nullptr ? at : at + 1);
+    }
+
+    // Counted and appended options get their values before the usage line checks
+    // which options are there. Actions are only for named options, so the positionals
+    // don't need to be stored first.
+    if (actions)
+        internal::finishActions(*this);
+
+    // Positionals for the patterns are matched once all of argv has been seen. Errors
+    // elsewhere in argv don't lose them: they're still matched, and if eval() stopped
+    // early or nothing matches, they go to the positionals in declaration order.
+    if (usePatterns && (i < argc || !MatchUsage(*this, argv, args, used, placed)))
+    {
+        for (int arg : args)
+            if (!AssignInOrder(*this, argv, arg, positional, taken, placed))
+                break;
+    }
+    StorePositionals(*this, argv, placed);
+
+    if (constraints)
+        internal::checkConstraints(*this);
+    if (types)
+        internal::convertTypes(*this);
+    if (!keyValueTables.empty())
+        internal::sortKeyValues(*this);
+
+    // Write converted values into any bound struct fields, falling back to defaults as
+    // get() does. A field with neither is left as the caller set it.
+    for (auto& b : bound)
+    {
+        const Value& value = values[b.value];
+        internal::Defaults::Entry* entry = nullptr;
+        const char* str = nullptr;
+        if (value.exists() || groupDefault(b.value))
+            str = value.string();
+        else if (defaults && (entry = defaults->find(b.value)) != nullptr)
+            str = defaults->materialize(*entry, value).string();
+        if (str == nullptr)
+            continue;
+        if (!b.apply(b.object, b.field, str))
+        {
+            badArgs = true;
+            errorMsg += std::string("bad value: ") + str + "\n";
+        }
+    }
+}
+
+// Each argument ends at a nul, and the buffer ends after the last one's
+void Cmdline::eval(char* args, size_t len)
+{
+    if (!scratch)
+        scratch.reset(new internal::Scratch);
+    std::vector<char*>& split = scratch->split;
+    split.clear();
+
+    args[len] = '\0';
+    for (size_t b = 0; b < len; b += strlen(args + b) + 1)
+        split.push_back(args + b);
+    if (split.empty())
+        split.push_back(args);
+    int argc = (int) split.size();
+    split.push_back(nullptr);
+    eval(argc, split.data());
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Note which arguments look like options, without looking anything up. Everything after
+// a "--" is positional, so it isn't needed until the whole of argv is.
+void Cmdline::index(int argc, char** argv)
+{
+    if (errorLength == std::string::npos)
+        errorLength = errorMsg.size(); // resolve() may add conversion errors
+    lazy.reset(new internal::Lazy);
+    lazy->argc = argc;
+    lazy->argv = argv;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* opt = argv[i];
+        if (opt[0] != '-' || opt[1] == '\0')
+            continue;
+        opt++;
+        if (*opt == '-') opt++;
+        if (*opt == '\0')
+            break;
+        const char* eq = strchr(opt, '=');
+        lazy->tokens.push_back(internal::Lazy::Token{ i, Fragment(opt, eq != nullptr ? eq : opt + strlen(opt)), -2 });
+    }
+
+    lazy->resolved.assign(values.size(), 0);
+    lazy->positional.assign(values.size(), 0);
+    for (auto& pos : positionals)
+        lazy->positional[options.find(pos)->second] = 1;
+}
+
+// Evaluate one named option the way eval() would: each time it appears it takes the
+// arguments after it, up to the next option, and the last time wins. Since the last
+// time wins, the walk goes through every token up to the end or an unknown option, so
+// each option asked about costs a pass over the tokens; a token's name is only looked
+// up on the first pass that reaches it. Positionals depend on every option's arity, so
+// they need all of argv.
+void Cmdline::resolve(int v) const
+{
+    internal::Lazy& l = *lazy;
+    if (v < 0 || (v < (int) l.resolved.size() && l.resolved[v]))
+        return;
+    if (l.resolved.size() < values.size())
+    {
+        l.resolved.resize(values.size(), 0); // values from groups included since
+        l.positional.resize(values.size(), 0);
+    }
 
-            // If it takes no args, it's a boolean
-            else
-                pos->second->set("True");
+    // Counting and appending need every occurrence, so they're left to eval()
+    Cmdline& cmd = const_cast<Cmdline&>(*this);
+    internal::Actions::Code code = actions ? actions->code(v) : internal::Actions::Store;
+    if (l.positional[v] || (code != internal::Actions::Store && code != internal::Actions::StoreTrue))
+    {
+        cmd.complete();
+        return;
+    }
+    l.resolved[v] = 1;
+
+    // A token that isn't a known option can still be the argument of the option before
+    // it, as in -o --weird, so each option's arguments are skipped the way eval() takes
+    // them. Only a token that isn't anyone's argument stops the lookups.
+    Value& value = cmd.values[v];
+    bool store = v >= (int) handlers.size() || handlers[v].store;
+    int taken = 0; // the last argument taken by an option so far
+    for (auto& t : l.tokens)
+    {
+        if (t.arg <= taken)
+            continue;
+        if (t.value == -2)
+            t.value = lookup(t.name.b, t.name.e);
+        if (t.value < 0 && l.argv[t.arg][1] != '-' && *t.name.e == '\0')
+        {
+            cmd.complete(); // a cluster of short options, or an error
+            return;
+        }
+        if (t.value < 0)
+            break; // eval() stops at an unknown option
+
+        const Value& option = values[t.value];
+        const char* eq = *t.name.e == '=' ? t.name.e + 1 : nullptr;
+        int i = t.arg;
+        int n = eq != nullptr ? 1 : 0;
+        while (n < option.maxArgs() && i + 1 < l.argc && !IsOption(*this, l.argv[i + 1]))
+        {
+            i += 1;
+            n += 1;
         }
+        taken = i;
+        if (t.value != v || !store)
+            continue;
+
+        if (value.maxArgs() == 0)
+            value.set("True");
+        else if (n > 0)
+            value.set(eq != nullptr ? eq : l.argv[t.arg + 1], &l.argv[eq != nullptr ? t.arg + 1 : t.arg + 2], n);
     }
+
+    if (types && types->find(v) != nullptr)
+        internal::convertType(cmd, types->slots[types->slotOf[v]]);
+}
+
+void Cmdline::complete()
+{
+    if (lazy)
+        eval(lazy->argc, lazy->argv);
 }
 
 //=================================================================================================
@@ -194,56 +788,388 @@ namespace internal
 class Parser
 {
 public:
-    Parser(const char* text, const char* textEnd, Cmdline* cmd);
+    Parser(const char* text, const char* textEnd, SpecSink* sink);
     bool parse();
 
 private:
     const char* text;
     const char* textEnd;
     bool linestart; // true when at beginning of line including whitespace
+    int lastValue; // the value of the latest declaration, for annotations
 
-    Cmdline* cmd; // pointer to upstream commandline
+    SpecSink* sink; // where parsed arguments go
 
-    struct Fragment
-    {
-		Fragment() { b = nullptr; e = nullptr; }
-        const char* b;
-        const char* e;
-    };
     bool TEXT(int& pos, Fragment& f);
+    bool USAGE(int& pos, Fragment& f);
+    bool OPTIONAL(int& pos, Fragment& f);
     bool POSITIONAL(int& pos, Fragment& f);
-    bool ARGUMENT(int& pos, Fragment& f);
-    bool NAMED(int& pos, Fragment& f, Value*& v);
+    bool ARGUMENT(int& pos, Fragment& f, bool option = false);
+    bool TYPE(Fragment& f, Fragment& type);
+    bool NAMED(int& pos, Fragment& f, int& v);
     bool NAMEDLIST(int& pos, Fragment& f);
+    void ARITY(int& pos, int& minArgs, int& maxArgs);
+    bool ANNOTATIONS(Fragment f);
 
     bool MatchChar(int& pos, char c);
-
     void ConsumeWhitespace(int& pos);
 };
+
+// Cmdline stores the spec into its map and value vector
+class CmdlineSink : public SpecSink
+{
+public:
+    CmdlineSink(Cmdline* cmd_, const Converters* converters_) : cmd(cmd_), converters(converters_) {}
+
+    int value(bool named) override
+    {
+        cmd->values.push_back(named ? Value("False", false) : Value());
+        return (int) cmd->values.size() - 1;
+    }
+
+    bool positional(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        cmd->values[v].arity(minArgs, maxArgs);
+        std::string arg = cmd->key(name.b, name.e);
+        cmd->options[arg] = v;
+        cmd->positionals.push_back(arg);
+        return true;
+    }
+
+    bool named(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        if (maxArgs > 0)
+            cmd->values[v].arity(minArgs, maxArgs);
+        cmd->options[cmd->key(name.b, name.e)] = v;
+        return true;
+    }
+
+    bool usage(Fragment section) override
+    {
+        if (!cmd->usagePatterns)
+            cmd->usagePatterns.reset(new Usage);
+        return compileUsage(section, *cmd->usagePatterns);
+    }
+
+    bool annotation(int v, Fragment key, Fragment body) override
+    {
+        if (key.e - key.b == 7 && strncmp(key.b, "default", 7) == 0)
+        {
+            if (!cmd->defaults)
+                cmd->defaults.reset(new Defaults);
+            if ((int) cmd->defaults->entries.size() <= v)
+                cmd->defaults->entries.resize(v + 1);
+            cmd->defaults->entries[v].text = body;
+            return true;
+        }
+        if (key.e - key.b == 6 && strncmp(key.b, "action", 6) == 0)
+            return addAction(*cmd, v, body);
+
+        static const struct { const char* key; Constraints::Kind kind; } kinds[] = {
+            { "conflicts", Constraints::Conflicts },
+            { "requires", Constraints::Requires },
+            { "implies", Constraints::Implies },
+            { "exclusive", Constraints::Exclusive },
+        };
+        for (auto& k : kinds)
+        {
+            if (strlen(k.key) != (size_t) (key.e - key.b) || strncmp(k.key, key.b, key.e - key.b) != 0)
+                continue;
+            if (!cmd->constraints)
+                cmd->constraints.reset(new Constraints);
+            cmd->constraints->declared.push_back({ v, k.kind, std::string(body.b, body.e) });
+        }
+        return true;
+    }
+
+    // Types are resolved as they're declared; an option keeps the first type it's given
+    bool typed(int v, Fragment name, Fragment type) override
+    {
+        const Converter* converter = converters->find(type.b, type.e);
+        if (converter == nullptr)
+        {
+            cmd->errorMsg += "unknown type in spec: " + std::string(type.b, type.e) + "\n";
+            return false;
+        }
+        if (!cmd->types)
+            cmd->types.reset(new Types);
+        if ((int) cmd->types->slotOf.size() <= v)
+            cmd->types->slotOf.resize(v + 1, -1);
+        if (cmd->types->slotOf[v] < 0)
+        {
+            cmd->types->slotOf[v] = (int) cmd->types->slots.size();
+            cmd->types->slots.push_back(Types::Slot{ v, name, type, *converter, 0, false });
+        }
+        return true;
+    }
+
+    bool keyValue(int v, bool list) override
+    {
+        for (auto& table : cmd->keyValueTables)
+            if (table.value == v)
+                return true;
+        cmd->keyValueTables.push_back(KeyValues(v, list));
+        return true;
+    }
+
+private:
+    Cmdline* cmd; // pointer to upstream commandline
+    const Converters* converters;
+};
+}
+
+bool internal::study(const char* text, const char* textEnd, SpecSink& sink)
+{
+    Parser parser(text, textEnd, &sink);
+    return parser.parse();
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace
+{
+// Records what a chunk's parser reports, with chunk-local value numbers, so it can be
+// replayed into the real sink in order once all the chunks are done
+class RecordingSink : public internal::SpecSink
+{
+public:
+    enum Kind { NewValue, Positional, Named, Usage, Annotation, Typed, KeyValue };
+    struct Event
+    {
+        Kind kind;
+        int value;
+        int minArgs;
+        int maxArgs;
+        Fragment a;
+        Fragment b;
+    };
+
+    int value(bool named) override
+    {
+        events.push_back(Event{ NewValue, named ? 1 : 0, 0, 0, Fragment(), Fragment() });
+        return numValues++;
+    }
+    bool positional(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        events.push_back(Event{ Positional, v, minArgs, maxArgs, name, Fragment() });
+        return true;
+    }
+    bool named(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        events.push_back(Event{ Named, v, minArgs, maxArgs, name, Fragment() });
+        return true;
+    }
+    bool usage(Fragment section) override
+    {
+        events.push_back(Event{ Usage, 0, 0, 0, section, Fragment() });
+        return true;
+    }
+    bool annotation(int v, Fragment key, Fragment body) override
+    {
+        events.push_back(Event{ Annotation, v, 0, 0, key, body });
+        return true;
+    }
+    bool typed(int v, Fragment name, Fragment type) override
+    {
+        events.push_back(Event{ Typed, v, 0, 0, name, type });
+        return true;
+    }
+    bool keyValue(int v, bool list) override
+    {
+        events.push_back(Event{ KeyValue, v, list ? 1 : 0, 0, Fragment(), Fragment() });
+        return true;
+    }
+
+    // Send the events on, mapping local values to the sink's. Returns false as soon as
+    // the sink refuses something, which is where a serial parse would have stopped.
+    bool replay(internal::SpecSink& sink)
+    {
+        std::vector<int> values;
+        values.reserve(numValues);
+        for (auto& e : events)
+        {
+            bool ok = true;
+            switch (e.kind)
+            {
+            case NewValue:
+                values.push_back(sink.value(e.value != 0));
+                ok = values.back() >= 0;
+                break;
+            case Positional: ok = sink.positional(e.a, values[e.value], e.minArgs, e.maxArgs); break;
+            case Named:      ok = sink.named(e.a, values[e.value], e.minArgs, e.maxArgs); break;
+            case Usage:      ok = sink.usage(e.a); break;
+            case Annotation: ok = sink.annotation(values[e.value], e.a, e.b); break;
+            case Typed:      ok = sink.typed(values[e.value], e.a, e.b); break;
+            case KeyValue:   ok = sink.keyValue(values[e.value], e.minArgs != 0); break;
+            }
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<Event> events;
+    int numValues = 0;
+    bool parsed = false;
+};
+
+// Is this the start of a usage section? The 'usage:' tag is case-insensitive. The
+// parser and the parallel split both ask, so they agree on where sections are.
+bool IsUsageTag(const char* p, const char* e)
+{
+    static const char tag[] = "usage:";
+    if (e - p < (int) sizeof(tag) - 1)
+        return false;
+    for (int i = 0; i < (int) sizeof(tag) - 1; i++)
+        if ((p[i] | 0x20) != tag[i])
+            return false;
+    return true;
+}
+
+// Is p at the start of a line that is safe to start a chunk at? It has to begin an
+// option declaration, so the parser's state going into it is the same as at the start
+// of a spec. A <positional> line won't do, since a declaration on the line before can
+// take it as a value. Nor will the rest of a list of synonyms, which goes on to the
+// next line after a comma. And it can't be inside a usage section, which runs to the
+// next blank line.
+bool SafeSplit(const char* text, const char* p, const char* textEnd)
+{
+    const char* q = p;
+    while (q < textEnd && (*q == ' ' || *q == '\t'))
+        q++;
+    if (q < textEnd && *q == '[')
+        q++;
+    if (q == textEnd || *q != '-')
+        return false;
+
+    const char* last = p; // just after the last character before p that isn't space
+    while (last > text && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r' || last[-1] == '\n'))
+        last--;
+    if (last > text && last[-1] == ',')
+        return false;
+
+    // Walk back a line at a time until a blank line (fine) or a usage tag (not fine)
+    const char* eol = p - 1; // the '\n' ending the previous line
+    while (eol > text)
+    {
+        const char* bol = eol;
+        while (bol > text && bol[-1] != '\n')
+            bol--;
+        const char* c = bol;
+        while (c < eol && (*c == ' ' || *c == '\t' || *c == '\r'))
+            c++;
+        if (c == eol)
+            return true;
+        if (IsUsageTag(c, eol))
+            return false;
+        eol = bol - 1;
+    }
+    return true;
+}
+}
+
+// Split the spec into up to threads chunks at safe line boundaries, parse them at the
+// same time, and replay what each found into sink in order. The sink sees exactly the
+// calls a serial parse would make, so duplicates and synonyms resolve the same way,
+// and the first syntax error stops the replay where the serial parse would stop.
+bool internal::studyParallel(const char* text, const char* textEnd, SpecSink& sink, int threads)
+{
+    std::vector<const char*> splits{ text };
+    for (int t = 1; t < threads; t++)
+    {
+        const char* p = std::max(splits.back(), text + (textEnd - text) * t / threads);
+        for (;;)
+        {
+            p = static_cast<const char*>(memchr(p, '\n', textEnd - p));
+            if (p == nullptr || ++p == textEnd || SafeSplit(text, p, textEnd))
+                break;
+        }
+        if (p == nullptr || p == textEnd)
+            break;
+        if (p != splits.back())
+            splits.push_back(p);
+    }
+    splits.push_back(textEnd);
+
+    int chunks = (int) splits.size() - 1;
+    if (chunks == 1)
+        return study(text, textEnd, sink);
+
+    std::vector<RecordingSink> recorded(chunks);
+    std::vector<std::thread> pool;
+    for (int c = 1; c < chunks; c++)
+    {
+        pool.emplace_back([&recorded, &splits, c]() {
+            recorded[c].parsed = study(splits[c], splits[c + 1], recorded[c]);
+        });
+    }
+    recorded[0].parsed = study(splits[0], splits[1], recorded[0]);
+    for (auto& t : pool)
+        t.join();
+
+    for (auto& r : recorded)
+    {
+        if (!r.replay(sink) || !r.parsed)
+            return false;
+    }
+    return true;
 }
 
 void Cmdline::study()
 {
-    internal::Parser parser(spec, specEnd, this);
-    if (!parser.parse())
+    study(Converters::builtin());
+}
+
+void Cmdline::study(const Converters& converters)
+{
+    const char* bad;
+    if (!validUtf8(spec, specEnd, &bad))
+    {
+        failed = true;
+        errorMsg += "spec is not valid UTF-8 at offset " + std::to_string(bad - spec) + "\n";
+        return;
+    }
+
+    // Big generated specs are split up and parsed on several threads
+    internal::CmdlineSink sink(this, &converters);
+    int threads = std::min((int) std::thread::hardware_concurrency(), (int) ((specEnd - spec) / internal::ParallelChunkBytes));
+    bool parsed = threads > 1
+        ? internal::studyParallel(spec, specEnd, sink, threads)
+        : internal::study(spec, specEnd, sink);
+    if (!parsed)
         failed = true; // save parsing error
+    if (usagePatterns && !internal::linkUsage(*this))
+        failed = true;
+    if (constraints && !internal::linkConstraints(*this))
+        failed = true;
+    if (types)
+        internal::linkTypes(*this);
+    if (actions && !internal::linkActions(*this))
+        failed = true;
+    initial = values;
 }
 
-internal::Parser::Parser(const char* text, const char* textEnd, Cmdline* cmd_)
-    : text(text), textEnd(textEnd), cmd(cmd_)
+internal::Parser::Parser(const char* text, const char* textEnd, SpecSink* sink_)
+    : text(text), textEnd(textEnd), sink(sink_)
 {
     linestart = true;
+    lastValue = -1;
 }
 
 // ------------------------------------------------------------------------------------------------
 
 // Grammar is something like this (where ^ means line start)
-//  CMDLINE ::= (TEXT | POSITIONAL | NAMEDLIST)
+//  CMDLINE ::= (TEXT | USAGE | OPTIONAL | POSITIONAL | NAMEDLIST)
 //  TEXT ::= string+
+//  USAGE ::= ^ 'usage:' string+ (up to a blank line)
+//  OPTIONAL ::= ^ '[' (POSITIONAL | NAMEDLIST) ']'
 //  POSITIONAL ::= ^ '<' ARGUMENT '>' TEXT
 //  NAMEDLIST ::= NAMED (',' NAMED)*
-//  NAMED ::= '-' '-'? ARGUMENT ('='? VALUE)?
+//  NAMED ::= '-' '-'? ARGUMENT ('='? VALUE)*
+//  VALUE ::= '<' ARGUMENT TYPE? '>' ARITY
+//  TYPE ::= ':' string+    (':@' after <key=value> for a list)
+//  ARITY ::= ('?' | '*' | '+' | '...' | '{' m (',' n?)? '}')?
 //  ARGUMENT ::= string+
+//  ANNOTATION ::= '(' key ':' string ')'   (inside TEXT, for the latest declaration)
 
 bool internal::Parser::parse()
 {
@@ -253,6 +1179,18 @@ bool internal::Parser::parse()
     {
 	    Fragment f;
         if (TEXT(pos, f))
+        {
+            // The text has been consumed, so a bad annotation at the end of the spec
+            // would otherwise look like a clean finish
+            if (!ANNOTATIONS(f))
+                return false;
+            continue;
+        }
+
+        if (USAGE(pos, f))
+            continue;
+
+        if (OPTIONAL(pos, f))
             continue;
 
         if (POSITIONAL(pos, f))
@@ -291,7 +1229,7 @@ bool internal::Parser::TEXT(int& pos, Fragment& f)
         }
 
         // Is this a symbol that terminates text mode?
-        if (linestart && (*e == '<' || *e == '[' || *e == '-'))
+        if (linestart && (*e == '<' || *e == '[' || *e == '-' || IsUsageTag(e, textEnd)))
             break;
 
         // See if we are no longer at the "start" of a line
@@ -310,6 +1248,63 @@ bool internal::Parser::TEXT(int& pos, Fragment& f)
 
 // ------------------------------------------------------------------------------------------------
 
+// Consume a usage section, which runs from 'usage:' up to a blank line. Usage lines
+// are compiled into a pattern program by the sink (see usage.cpp).
+bool internal::Parser::USAGE(int& pos, Fragment& f)
+{
+    const char* b = &text[pos];
+    if (!linestart || !IsUsageTag(b, textEnd))
+        return false;
+
+    const char* e = b;
+    for (;;)
+    {
+        // Find the end of this line, and see if the next one is blank
+        while (e < textEnd && *e != '\n')
+            e++;
+        if (e == textEnd)
+            break;
+        const char* next = e + 1;
+        const char* p = next;
+        while (p < textEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+        if (p == textEnd || *p == '\n')
+            break;
+        e = next;
+    }
+
+    f.b = b;
+    f.e = e;
+    if (!sink->usage(f))
+        return false;
+
+    pos = e - text;
+    linestart = true;
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Consume a bracketed declaration like [--version] or [<file>]. The brackets say the
+// argument is optional, which is the default anyway, so this is just another way to
+// write a POSITIONAL or a NAMEDLIST.
+bool internal::Parser::OPTIONAL(int& pos, Fragment& f)
+{
+    int p{ pos };
+
+    if (!linestart || !MatchChar(p, '['))
+        return false;
+    if (!POSITIONAL(p, f) && !NAMEDLIST(p, f))
+        return false;
+    if (!MatchChar(p, ']'))
+        return false;
+
+    pos = p;
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 // Consume a complete POSITIONAL nonterminal or consume nothing
 bool internal::Parser::POSITIONAL(int& pos, Fragment& f)
 {
@@ -319,8 +1314,9 @@ bool internal::Parser::POSITIONAL(int& pos, Fragment& f)
     if (!MatchChar(p, '<'))
         return false;
 
-    // Consume an ARGUMENT
-    if (!ARGUMENT(p, f))
+    // Consume an ARGUMENT, which may have a type
+    Fragment type;
+    if (!ARGUMENT(p, f) || !TYPE(f, type) || f.b == f.e)
         return false;
 
     // Consume the end symbol
@@ -328,12 +1324,18 @@ bool internal::Parser::POSITIONAL(int& pos, Fragment& f)
     if (!MatchChar(p, '>'))
         return false;
 
+    // A positional takes one argument unless it says otherwise
+    int minArgs = 1;
+    int maxArgs = 1;
+    ARITY(p, minArgs, maxArgs);
+
     // At this point, we have all the pieces for a new positional argument
-    std::string arg(f.b, f.e - f.b); // TBD force to lower case?
-    auto v = new Value;
-    cmd->values.push_back(v);
-    cmd->options[arg] = v;
-    cmd->positionals.push_back(arg);
+    int v = sink->value(false);
+    if (v < 0 || !sink->positional(f, v, minArgs, maxArgs))
+        return false;
+    if (type.b != nullptr && !sink->typed(v, f, type))
+        return false;
+    lastValue = v;
 
     pos = p;
     return true;
@@ -347,7 +1349,7 @@ bool internal::Parser::NAMEDLIST(int& pos, Fragment& f)
 
     // We share the same Value among all the synonyms, and we
     // use the first one created
-    Value* v = nullptr;
+    int v = -1;
 
     // there must be at least one NAMED to start with
     if (!NAMED(p, f, v))
@@ -367,13 +1369,14 @@ bool internal::Parser::NAMEDLIST(int& pos, Fragment& f)
         pstart = p; // we successfully found another token
     }
     p = pstart;
+    lastValue = v;
 
     pos = p;
     return true;
 }
 
 // Consume a complete NAMED nonterminal or consume nothing
-bool internal::Parser::NAMED(int& pos, Fragment& f, Value*& v)
+bool internal::Parser::NAMED(int& pos, Fragment& f, int& v)
 {
     int p{ pos };
 
@@ -383,59 +1386,168 @@ bool internal::Parser::NAMED(int& pos, Fragment& f, Value*& v)
     MatchChar(p, '-');
 
     // Consume an ARGUMENT
-    if (!ARGUMENT(p, f))
+    if (!ARGUMENT(p, f, true))
         return false;
 
-    // Consume optional VALUEs
-    int narg = 0;
+    // Consume optional VALUEs, adding up the range of arguments they take. A value
+    // with a type but no name, as in <:bool>, only gives the option a type.
+    int minArgs = 0;
+    int maxArgs = 0;
+    Fragment type;
+    bool pairs = false;
+    bool list = false;
     while (p < textEnd - text)
     {
         int argpos{ p };
         Fragment farg;
+        Fragment ftype;
 
         ConsumeWhitespace(argpos);
         MatchChar(argpos, '='); // optional
 
         if (!MatchChar(argpos, '<'))
             break;
-        if (!ARGUMENT(argpos, farg))
+        if (!ARGUMENT(argpos, farg) || !TYPE(farg, ftype))
             break;
-        narg += 1;
         if (!MatchChar(argpos, '>'))
             break;
 
+        // A <key=value> value collects pairs, and a type of @ keeps every value for
+        // a key rather than the last
+        if (memchr(farg.b, '=', farg.e - farg.b) != nullptr)
+            pairs = true;
+        if (ftype.e - ftype.b == 1 && *ftype.b == '@')
+            list = true;
+        else if (type.b == nullptr)
+            type = ftype;
+        int lo = farg.b == farg.e ? 0 : 1;
+        int hi = lo;
+        ARITY(argpos, lo, hi);
+        minArgs += lo;
+        maxArgs = (maxArgs == Value::Many || hi == Value::Many) ? (int) Value::Many : maxArgs + hi;
+
         p = argpos;
     }
 
     // We now have a named argument. The simple version is bool-if-exists, or
-    // an argument count if it takes further arguments
-    if (v == nullptr)
+    // a range of arguments if it takes further arguments
+    if (v < 0)
+        v = sink->value(true);
+    if (v < 0 || !sink->named(f, v, minArgs, maxArgs))
+        return false;
+    if (type.b != nullptr && !sink->typed(v, f, type))
+        return false;
+    if (pairs && !sink->keyValue(v, list))
+        return false;
+
+    pos = p;
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Consume an optional ARITY suffix after a value, as in <file>... or <n>{1,3}, and set
+// the range of arguments it allows. Without a suffix, the range is left alone.
+//  ?  0 or 1      *  0 or more     + or ...  1 or more
+//  {m}  exactly m     {m,}  m or more     {m,n}  m to n
+void internal::Parser::ARITY(int& pos, int& minArgs, int& maxArgs)
+{
+    const char* p = &text[pos];
+    if (p < textEnd && *p == '?')
+        minArgs = 0, maxArgs = 1, p += 1;
+    else if (p < textEnd && *p == '*')
+        minArgs = 0, maxArgs = Value::Many, p += 1;
+    else if (p < textEnd && *p == '+')
+        minArgs = 1, maxArgs = Value::Many, p += 1;
+    else if (textEnd - p >= 3 && p[0] == '.' && p[1] == '.' && p[2] == '.')
+        minArgs = 1, maxArgs = Value::Many, p += 3;
+    else if (p < textEnd && *p == '{')
     {
-        v = new Value("False", false);
-        cmd->values.push_back(v);
+        // Parse the bounds, and leave everything alone if they're malformed
+        const char* q = p + 1;
+        auto number = [this, &q](int& n) {
+            if (q == textEnd || *q < '0' || *q > '9')
+                return false;
+            for (n = 0; q < textEnd && *q >= '0' && *q <= '9'; q++)
+                n = n * 10 + (*q - '0');
+            return true;
+        };
+
+        int lo, hi;
+        if (!number(lo))
+            return;
+        hi = lo;
+        if (q < textEnd && *q == ',')
+        {
+            q += 1;
+            if (!number(hi))
+                hi = Value::Many;
+        }
+        if (q == textEnd || *q != '}' || hi < lo)
+            return;
+        minArgs = lo;
+        maxArgs = hi;
+        p = q + 1;
     }
-    if (narg > 0)
-        v->nargs(narg);
+    pos = p - text;
+}
+
+// ------------------------------------------------------------------------------------------------
 
-    std::string arg(f.b, f.e - f.b);
-    cmd->options[arg] = v;
+// Report the annotations in a run of help text to the sink. An annotation is a key
+// of letters and dashes right after '(' and followed by ':', as in (requires: --bare),
+// so ordinary parenthetical text like (implies bare) is left alone. Text before the
+// first declaration has nothing to annotate.
+bool internal::Parser::ANNOTATIONS(Fragment f)
+{
+    if (lastValue < 0)
+        return true;
 
-    pos = p;
+    for (const char* p = f.b; p < f.e; p++)
+    {
+        if (*p != '(')
+            continue;
+        const char* k = p + 1;
+        const char* ke = k;
+        while (ke < f.e && ((*ke >= 'a' && *ke <= 'z') || *ke == '-'))
+            ke++;
+        if (ke == k || ke == f.e || *ke != ':')
+            continue;
+
+        const char* b = ke + 1;
+        while (b < f.e && (*b == ' ' || *b == '\t'))
+            b++;
+        const char* e = b;
+        while (e < f.e && *e != ')' && *e != '\n')
+            e++;
+        if (e == f.e || *e != ')')
+            continue;
+
+        if (!sink->annotation(lastValue, Fragment(k, ke), Fragment(b, e)))
+            return false;
+        p = e;
+    }
     return true;
 }
 
 // ------------------------------------------------------------------------------------------------
 
 // Consume an ARGUMENT non-terminal. For now, this is just a name, e.g. anything up
-// a non-argument character
-bool internal::Parser::ARGUMENT(int& pos, Fragment& f)
+// a non-argument character. Option names also stop at '=', as in --opt=<value>, but
+// value names don't, as in <key=value>. Value names can end in ',', as in the list
+// type <ids:int,>.
+bool internal::Parser::ARGUMENT(int& pos, Fragment& f, bool option)
 {
     auto begin = pos;
     const char* b = &text[pos];
     const char* e = b;
     for (; e < textEnd; e++)
     {
-        if (*e == ']' || *e == '>' || *e == ' ' || *e == '\n' || *e == ',')
+        if (*e == ']' || *e == '>' || *e == ' ' || *e == '\n')
+            break;
+        if (*e == ',' && (option || e + 1 == textEnd || e[1] != '>'))
+            break;
+        if (option && *e == '=')
             break;
     }
     pos = e - text;
@@ -445,9 +1557,23 @@ bool internal::Parser::ARGUMENT(int& pos, Fragment& f)
     return pos > begin;
 }
 
+// Split a TYPE off the end of an argument name, as in <n:int>, leaving type null if
+// there isn't one. An empty type is an error.
+bool internal::Parser::TYPE(Fragment& f, Fragment& type)
+{
+    const char* colon = static_cast<const char*>(memchr(f.b, ':', f.e - f.b));
+    if (colon == nullptr)
+        return true;
+    type = Fragment(colon + 1, f.e);
+    f.e = colon;
+    return type.b != type.e;
+}
+
+// The spec isn't necessarily nul-terminated (it can be a mapped file, or a chunk of a
+// bigger spec), so these stop at textEnd
 bool internal::Parser::MatchChar(int& pos, char c)
 {
-    if (text[pos] != c)
+    if (text + pos >= textEnd || text[pos] != c)
         return false;
     pos += 1;
     return true;
@@ -456,7 +1582,7 @@ bool internal::Parser::MatchChar(int& pos, char c)
 void internal::Parser::ConsumeWhitespace(int& pos)
 {
 	const char* p = &text[pos];
-	while (*p)
+	while (p < textEnd)
 	{
 		if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
 			p++;
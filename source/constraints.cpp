@@ -0,0 +1,241 @@
+//=================================================================================================
+// constraints.cpp
+//  - compile option constraints into bitmasks, and check them after eval
+//=================================================================================================
+
+#include "cmdline/cmdline.h"
+#include "cmdline/spec.h"
+#include "cmdline/utf8.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cmdline
+{
+
+// Constraints are written in the help text of a declaration:
+//
+//  -v, --verbose    be more verbose (conflicts: --quiet)
+//  --mirror         create a mirror repository (implies: --bare)
+//  --dissociate     use --reference only while cloning (requires: --reference)
+//  --ipv4           use IPv4 addresses only (exclusive: address)
+//  --ipv6           use IPv6 addresses only (exclusive: address)
+//
+// conflicts, requires and implies take a list of options or <positionals>; exclusive
+// takes a group name, and at most one option in a group may be given. Names can be
+// forward references, so they're resolved once the whole spec has been studied.
+//
+// Study turns each kind into a bitmask with a bit for every value index, and exclusive
+// groups become conflicts between their members. Only values that take part in some
+// constraint get a row of masks, so the memory is (constrained values x words) rather
+// than growing with the square of the spec. eval() then builds the set of values that
+// were seen and tests each present option's masks against it a word at a time, so the
+// cost is (present constrained options x words) rather than pairs of options.
+// Implications are applied first, one level deep, so implied options are checked too.
+// An implied flag reads as if it had been given once, so its action still applies.
+
+namespace
+{
+int LowestBit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int) index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+void SetBit(uint64_t* row, int v)
+{
+    row[v / 64] |= uint64_t(1) << (v % 64);
+}
+
+// Split a list like "-q, --quiet <file>" into names as they appear in the option map
+bool Resolve(Cmdline& cmd, const std::string& list, std::vector<int>& values)
+{
+    size_t p = 0;
+    for (;;)
+    {
+        p = list.find_first_not_of(" \t,", p);
+        if (p == std::string::npos)
+            return true;
+        size_t e = list.find_first_of(" \t,", p);
+        if (e == std::string::npos)
+            e = list.size();
+
+        std::string token = list.substr(p, e - p);
+        std::string name = token;
+        p = e;
+        if (name.size() > 1 && name.front() == '<' && name.back() == '>')
+            name = name.substr(1, name.size() - 2);
+        else
+            name.erase(0, std::min(name.find_first_not_of('-'), (size_t) 2));
+
+        auto pos = cmd.options.find(cmd.key(name.c_str()));
+        if (pos == cmd.options.end())
+        {
+            cmd.errorMsg += "unknown option in constraint: " + token + "\n";
+            return false;
+        }
+        values.push_back(pos->second);
+    }
+}
+}
+
+// Compile the declared constraints into masks, with a row for each constrained value.
+// Returns false if a constraint names something that isn't in the spec, or implies an
+// option that takes arguments.
+bool internal::linkConstraints(Cmdline& cmd)
+{
+    Constraints& c = *cmd.constraints;
+    int numValues = (int) cmd.values.size();
+    c.words = (numValues + 63) / 64;
+    c.constrained.assign(c.words, 0);
+    c.seen.assign(c.words, 0);
+
+    // Errors name options the way a user would type them, preferring the long name
+    c.names.assign(numValues, std::string());
+    for (auto& opt : cmd.options)
+    {
+        bool positional = std::find(cmd.positionals.begin(), cmd.positionals.end(), opt.first) != cmd.positionals.end();
+        std::string name = positional ? "<" + opt.first + ">" : (utf8Length(opt.first.data(), opt.first.data() + opt.first.size()) == 1 ? "-" : "--") + opt.first;
+        if (name.size() > c.names[opt.second].size())
+            c.names[opt.second] = name;
+    }
+
+    // Resolve the names first, to find out which values need rows
+    std::map<std::string, std::vector<int>> groups;
+    std::vector<std::vector<int>> targets(c.declared.size());
+    bool ok = true;
+    for (size_t k = 0; k < c.declared.size(); k++)
+    {
+        auto& d = c.declared[k];
+        SetBit(c.constrained.data(), d.value);
+        if (d.kind == Constraints::Exclusive)
+            groups[d.names].push_back(d.value);
+        else if (!Resolve(cmd, d.names, targets[k]))
+            ok = false;
+        else if (d.kind == Constraints::Conflicts)
+            for (int t : targets[k])
+                SetBit(c.constrained.data(), t); // conflicts go both ways
+    }
+
+    int rows = 0;
+    c.rowOf.assign(numValues, -1);
+    for (int w = 0; w < c.words; w++)
+        for (uint64_t bits = c.constrained[w]; bits != 0; bits &= bits - 1)
+            c.rowOf[w * 64 + LowestBit(bits)] = rows++;
+    c.conflicts.assign(rows * c.words, 0);
+    c.required.assign(rows * c.words, 0);
+    c.implies.assign(rows * c.words, 0);
+
+    for (size_t k = 0; k < c.declared.size(); k++)
+    {
+        auto& d = c.declared[k];
+        size_t row = c.rowOf[d.value] * c.words;
+        for (int t : targets[k])
+        {
+            switch (d.kind)
+            {
+            case Constraints::Conflicts:
+                // Each pair is reported once, by the lower index
+                SetBit(&c.conflicts[row], t);
+                SetBit(&c.conflicts[c.rowOf[t] * c.words], d.value);
+                break;
+            case Constraints::Requires:
+                SetBit(&c.required[row], t);
+                break;
+            case Constraints::Implies:
+                if (cmd.values[t].maxArgs() != 0)
+                {
+                    cmd.errorMsg += "can't imply an option that takes arguments: " + c.names[t] + "\n";
+                    ok = false;
+                }
+                SetBit(&c.implies[row], t);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    for (auto& group : groups)
+    {
+        for (int a : group.second)
+            for (int b : group.second)
+                if (a != b)
+                    SetBit(&c.conflicts[c.rowOf[a] * c.words], b);
+    }
+
+    return ok;
+}
+
+// Test the constraints against the values that were given. Errors go to errorMsg and
+// set badArgs. Returns false if anything failed.
+bool internal::checkConstraints(Cmdline& cmd)
+{
+    Constraints& c = *cmd.constraints;
+    std::fill(c.seen.begin(), c.seen.end(), 0);
+    for (int v = 0; v < (int) c.rowOf.size(); v++) // values from included groups aren't constrained
+        if (cmd.values[v].exists())
+            SetBit(c.seen.data(), v);
+
+    // Turn on implied flags first
+    for (int w = 0; w < c.words; w++)
+    {
+        for (uint64_t bits = c.seen[w] & c.constrained[w]; bits != 0; bits &= bits - 1)
+        {
+            const uint64_t* implies = &c.implies[c.rowOf[w * 64 + LowestBit(bits)] * c.words];
+            for (int i = 0; i < c.words; i++)
+            {
+                uint64_t added = implies[i] & ~c.seen[i];
+                c.seen[i] |= added;
+                for (; added != 0; added &= added - 1)
+                {
+                    int t = i * 64 + LowestBit(added);
+                    cmd.values[t].set(internal::flagValue(cmd, t));
+                }
+            }
+        }
+    }
+
+    bool ok = true;
+    for (int w = 0; w < c.words; w++)
+    {
+        for (uint64_t bits = c.seen[w] & c.constrained[w]; bits != 0; bits &= bits - 1)
+        {
+            int v = w * 64 + LowestBit(bits);
+            const uint64_t* conflicts = &c.conflicts[c.rowOf[v] * c.words];
+            const uint64_t* required = &c.required[c.rowOf[v] * c.words];
+            for (int i = 0; i < c.words; i++)
+            {
+                // Only report conflicts with higher indices, so each pair comes up once
+                uint64_t clash = conflicts[i] & c.seen[i];
+                if (i < w)
+                    clash = 0;
+                else if (i == w)
+                    clash &= ~((uint64_t(2) << (v % 64)) - 1);
+                uint64_t missing = required[i] & ~c.seen[i];
+                if ((clash | missing) == 0)
+                    continue;
+
+                ok = false;
+                for (; clash != 0; clash &= clash - 1)
+                    cmd.errorMsg += "option " + c.names[v] + " conflicts with " + c.names[i * 64 + LowestBit(clash)] + "\n";
+                for (; missing != 0; missing &= missing - 1)
+                    cmd.errorMsg += "option " + c.names[v] + " requires " + c.names[i * 64 + LowestBit(missing)] + "\n";
+            }
+        }
+    }
+
+    if (!ok)
+        cmd.badArgs = true;
+    return ok;
+}
+
+} // namespace cmdline
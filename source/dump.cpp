@@ -0,0 +1,247 @@
+//=================================================================================================
+// dump.cpp
+//  - declaration-ordered results, and formatting a parse for logs
+//=================================================================================================
+
+#include "cmdline/cmdline.h"
+#include "cmdline/group.h"
+#include "cmdline/spec.h"
+#include "cmdline/utf8.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace cmdline
+{
+
+namespace
+{
+void Append(std::string& out, const char* s)
+{
+    out.append(s, strlen(s));
+}
+
+void AppendInt(std::string& out, long long n)
+{
+    char buf[24];
+    out.append(buf, snprintf(buf, sizeof(buf), "%lld", n));
+}
+
+// A string with backslashes and control characters escaped as JSON escapes them, and
+// quotes too for JSON, so that an argument can't add lines to a log. Everything else,
+// including UTF-8, is copied as it is, a run at a time.
+void AppendEscaped(std::string& out, const char* s, bool json)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char* run = s;
+    for (; *s != '\0'; s++)
+    {
+        unsigned char c = (unsigned char) *s;
+        if (c >= 0x20 && (c != '"' || !json) && c != '\\')
+            continue;
+        out.append(run, s - run);
+        run = s + 1;
+        char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+        if (c == '"' || c == '\\')
+            out.append(escape, 1).push_back((char) c);
+        else if (c == '\n')
+            out.append("\\n", 2);
+        else if (c == '\t')
+            out.append("\\t", 2);
+        else
+            out.append(escape, 6);
+    }
+    out.append(run, s - run);
+}
+
+void AppendJson(std::string& out, const char* s)
+{
+    out.push_back('"');
+    AppendEscaped(out, s, true);
+    out.push_back('"');
+}
+}
+
+// The name for each value is its longest, as constraint errors use, looked up once
+// when the set of values changes; after that a reset just clears the indices
+void internal::resetResults(Cmdline& cmd)
+{
+    int numValues = (int) cmd.values.size();
+    if ((int) cmd.parsed.size() != numValues)
+    {
+        cmd.parsed.assign(numValues, Parsed{ "", nullptr, -1, false });
+        auto name = [&cmd](const std::string& n, int v) {
+            if (n.size() > strlen(cmd.parsed[v].name))
+                cmd.parsed[v].name = n.c_str();
+        };
+        for (auto& opt : cmd.options)
+            name(opt.first, opt.second);
+        for (auto& g : cmd.groups)
+            for (auto& opt : g.group->names())
+                if (cmd.lookup(opt.first.c_str()) == g.base + opt.second)
+                    name(opt.first, g.base + opt.second);
+        for (auto& pos : cmd.positionals)
+        {
+            int v = cmd.options.find(pos)->second;
+            cmd.parsed[v].name = cmd.options.find(pos)->first.c_str();
+            cmd.parsed[v].positional = true;
+        }
+    }
+
+    for (int v = 0; v < numValues; v++)
+    {
+        cmd.parsed[v].value = &cmd.values[v];
+        cmd.parsed[v].arg = -1;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+const std::vector<Parsed>& Cmdline::results() const
+{
+    if (lazy)
+        const_cast<Cmdline*>(this)->complete();
+    return parsed;
+}
+
+void Cmdline::dump(std::string& out, DumpFormat format) const
+{
+    if (lazy)
+        const_cast<Cmdline*>(this)->complete();
+    if (format == DumpText)
+    {
+        for (auto& p : parsed)
+        {
+            // Options are written the way they're typed, -j or --jobs
+            Append(out, p.positional ? "<" : utf8Length(p.name, p.name + strlen(p.name)) == 1 ? "-" : "--");
+            AppendEscaped(out, p.name, false);
+            Append(out, p.positional ? ">" : "");
+            if (!p.value->exists())
+            {
+                out.append(" (not given)\n");
+                continue;
+            }
+            for (int i = 0; i < p.value->count(); i++)
+            {
+                out.push_back(i == 0 ? '=' : ' ');
+                AppendEscaped(out, p.value->arg(i), false);
+            }
+            out.append(" (arg ");
+            AppendInt(out, p.arg);
+            out.append(")\n");
+        }
+        return;
+    }
+
+    out.append("{\"failed\":");
+    Append(out, failed ? "true" : "false");
+    out.append(",\"badArgs\":");
+    Append(out, badArgs ? "true" : "false");
+    out.append(",\"values\":[");
+    for (auto& p : parsed)
+    {
+        if (&p != parsed.data())
+            out.push_back(',');
+        out.append("{\"name\":");
+        AppendJson(out, p.name);
+        if (p.positional)
+            out.append(",\"positional\":true");
+        if (p.value->exists())
+        {
+            out.append(",\"arg\":");
+            AppendInt(out, p.arg);
+            out.append(",\"args\":[");
+            for (int i = 0; i < p.value->count(); i++)
+            {
+                if (i > 0)
+                    out.push_back(',');
+                AppendJson(out, p.value->arg(i));
+            }
+            out.push_back(']');
+        }
+        out.push_back('}');
+    }
+    out.append("]}\n");
+}
+
+// ------------------------------------------------------------------------------------------------
+
+const std::string Cmdline::state() const
+{
+    std::string buf;
+    state(buf);
+    return buf;
+}
+
+void Cmdline::state(std::string& out) const
+{
+    if (lazy)
+        const_cast<Cmdline*>(this)->complete();
+    // argv parts
+    out.append("Argv substrings: (");
+    AppendInt(out, argv_parts.size());
+    out.append(")\n");
+    for (auto& part : argv_parts)
+        out.append("    ").append(part.b, part.e - part.b).push_back('\n');
+
+    // positionals
+    out.append("Positional arguments: (");
+    AppendInt(out, positionals.size());
+    out.append(")\n");
+    for (auto& pos : positionals)
+        out.append("    ").append(pos).push_back('\n');
+
+    // options
+    int used = 0;
+    for (auto& opt : options)
+        if (values[opt.second].exists())
+            used += 1;
+
+    out.append("Options used: (");
+    AppendInt(out, used);
+    out.append(")\n");
+    for (auto& opt : options)
+    {
+        if (values[opt.second].exists())
+        {
+            out.append("    ").append(opt.first).append(": ");
+            values[opt.second].print(out);
+            out.push_back('\n');
+        }
+    }
+
+    out.append("Options not used: (");
+    AppendInt(out, options.size() - used);
+    out.append(")\n");
+    for (auto& opt : options)
+    {
+        if (!values[opt.second].exists())
+        {
+            out.append("    ").append(opt.first).append(": ");
+            values[opt.second].print(out);
+            out.push_back('\n');
+        }
+    }
+}
+
+const std::string Value::print() const
+{
+    std::string buf;
+    print(buf);
+    return buf;
+}
+
+void Value::print(std::string& out) const
+{
+    out.append("{ exist: ");
+    Append(out, valid ? "true" : "false");
+    out.append(", nargs: ");
+    AppendInt(out, num_args);
+    out.append(", str: ");
+    Append(out, str == nullptr ? "<null>" : str);
+    for (int i = 1; i < num_values; i++)
+        out.append(", ").append(rest[i - 1]);
+    out.append("}");
+}
+
+} // namespace cmdline
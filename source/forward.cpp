@@ -0,0 +1,234 @@
+//=================================================================================================
+// forward.cpp
+//  - building a child's argv from a parse, for wrappers and launchers
+//=================================================================================================
+
+#include "cmdline/forward.h"
+#include "cmdline/utf8.h"
+
+#include <string.h>
+
+namespace cmdline
+{
+
+ArgvBuilder::ArgvBuilder(Cmdline& cmd_) : cmd(cmd_), programName(nullptr), count(0)
+{
+    cmd.complete();
+}
+
+void ArgvBuilder::program(const char* name)
+{
+    programName = name;
+}
+
+bool ArgvBuilder::drop(const char* option)
+{
+    return replace(option, nullptr, 0);
+}
+
+bool ArgvBuilder::replace(const char* option, std::initializer_list<const char*> args)
+{
+    return replace(option, args.begin(), (int) args.size());
+}
+
+// A later edit of the same option takes the place of an earlier one
+bool ArgvBuilder::replace(const char* option, const char* const* args, int n)
+{
+    int v = cmd.lookup(option);
+    if (v < 0)
+        return false;
+    Edit edit{ v, (int) offsets.size(), n, false, false };
+    for (int k = 0; k < n; k++)
+        offsets.push_back(copy(args[k]));
+    if (Edit* old = find(v))
+        *old = edit;
+    else
+        edits.push_back(edit);
+    return true;
+}
+
+// Spelled the way a user would type it: a short name takes its value as the next
+// argument, which every parser understands, and a long one as --name=value
+bool ArgvBuilder::set(const char* option, const char* value)
+{
+    const std::string* name = nullptr;
+    int v = cmd.lookup(option, option + strlen(option), &name);
+    if (v < 0)
+        return false;
+
+    bool isShort = utf8Length(name->data(), name->data() + name->size()) == 1;
+    Edit edit{ v, (int) offsets.size(), 1, true, false };
+    offsets.push_back(text.size());
+    text.append(isShort ? "-" : "--").append(*name);
+    if (value != nullptr && isShort)
+    {
+        text.push_back('\0');
+        edit.n = 2;
+        offsets.push_back(copy(value));
+    }
+    else
+    {
+        if (value != nullptr)
+            text.append("=").append(value);
+        text.push_back('\0');
+    }
+
+    if (Edit* old = find(v))
+        *old = edit;
+    else
+        edits.push_back(edit);
+    return true;
+}
+
+void ArgvBuilder::add(std::initializer_list<const char*> args)
+{
+    add(args.begin(), (int) args.size());
+}
+
+void ArgvBuilder::add(const char* const* args, int n)
+{
+    edits.push_back(Edit{ -1, (int) offsets.size(), n, true, false });
+    for (int k = 0; k < n; k++)
+        offsets.push_back(copy(args[k]));
+}
+
+int ArgvBuilder::copy(const char* str)
+{
+    size_t at = text.size();
+    text.append(str).push_back('\0');
+    return (int) at;
+}
+
+ArgvBuilder::Edit* ArgvBuilder::find(int v)
+{
+    for (auto& edit : edits)
+        if (edit.value == v)
+            return &edit;
+    return nullptr;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// The pointers, then the strings, in one block of pointer-sized words
+char** ArgvBuilder::build()
+{
+    size_t rebuilt = 0;
+    int n = emit(nullptr, nullptr, rebuilt);
+    size_t words = n + 1 + (text.size() + rebuilt + sizeof(char*) - 1) / sizeof(char*);
+    block.reset(new char*[words]);
+    char* strings = reinterpret_cast<char*>(block.get() + n + 1);
+    memcpy(strings, text.data(), text.size());
+    rebuilt = 0;
+    count = emit(block.get(), strings, rebuilt);
+    block[count] = nullptr;
+    return block.get();
+}
+
+// Walk the original argv, writing the new one to out if it isn't null. Rebuilt clusters
+// are written after the copied strings, and rebuilt is how many bytes they take.
+// Returns the number of arguments.
+int ArgvBuilder::emit(char** out, char* strings, size_t& rebuilt)
+{
+    const internal::Scratch* scratch = cmd.scratch.get();
+    int argc = scratch != nullptr ? scratch->argc : 0;
+    char** argv = scratch != nullptr ? scratch->argv : nullptr;
+
+    int n = 0;
+    auto put = [&](char* arg) {
+        if (out != nullptr)
+            out[n] = arg;
+        n += 1;
+    };
+    auto putEdit = [&](const Edit& edit) {
+        for (int k = 0; k < edit.n; k++)
+            put(strings + offsets[edit.first + k]);
+    };
+
+    // An edited option's replacement goes where it's first seen
+    for (auto& edit : edits)
+        edit.placed = false;
+    auto putAdded = [&]() {
+        for (auto& edit : edits)
+            if (!edit.placed && edit.orAdd)
+                putEdit(edit), edit.placed = true;
+    };
+
+    // A cluster that an edit touches is split. The edits go first and then the options
+    // that are left, as one new argument, since the last of them may take the arguments
+    // after the cluster.
+    size_t c = 0;
+    auto putCluster = [&](int i) {
+        const auto& clustered = scratch->clustered;
+        size_t b = c;
+        bool touched = false;
+        for (; c < clustered.size() && clustered[c].arg == i; c++)
+            touched = touched || find(clustered[c].value) != nullptr;
+        if (!touched)
+        {
+            put(argv[i]);
+            return;
+        }
+
+        char* rest = strings != nullptr ? strings + text.size() + rebuilt : nullptr;
+        size_t len = 1;
+        for (size_t k = b; k < c; k++)
+        {
+            Edit* edit = find(clustered[k].value);
+            if (edit != nullptr)
+            {
+                if (!edit->placed)
+                    putEdit(*edit), edit->placed = true;
+                continue;
+            }
+            const char* at = clustered[k].at;
+            size_t n = (k + 1 < c ? clustered[k + 1].at : at + strlen(at)) - at;
+            if (rest != nullptr)
+                memcpy(rest + len, at, n);
+            len += n;
+        }
+        if (len == 1)
+            return; // every option in it was edited
+        if (rest != nullptr)
+            rest[0] = '-', rest[len] = '\0';
+        put(rest);
+        rebuilt += len + 1;
+    };
+
+    if (programName != nullptr || argc > 0)
+        put(programName != nullptr ? const_cast<char*>(programName) : argv[0]);
+
+    bool added = false;
+    for (int i = 1; i < argc; i++)
+    {
+        int v = scratch->owner[i];
+        if (c < scratch->clustered.size() && scratch->clustered[c].arg == i)
+        {
+            putCluster(i);
+            continue;
+        }
+        if (v < 0)
+        {
+            if (!added && strcmp(argv[i], "--") == 0)
+            {
+                putAdded();
+                added = true;
+            }
+            put(argv[i]);
+            continue;
+        }
+
+        Edit* edit = find(v);
+        if (edit == nullptr)
+            put(argv[i]);
+        else if (!edit->placed)
+        {
+            putEdit(*edit);
+            edit->placed = true;
+        }
+    }
+    if (!added)
+        putAdded();
+    return n;
+}
+
+} // namespace cmdline
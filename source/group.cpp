@@ -0,0 +1,125 @@
+//=================================================================================================
+// group.cpp
+//  - option groups studied once and shared between parsers
+//=================================================================================================
+
+#include "cmdline/group.h"
+#include "cmdline/utf8.h"
+
+#include <string.h>
+
+namespace cmdline
+{
+
+namespace
+{
+char* Copy(const char* spec)
+{
+    size_t n = strlen(spec) + 1;
+    char* text = new char[n];
+    memcpy(text, spec, n);
+    return text;
+}
+}
+
+std::shared_ptr<const OptionGroup> OptionGroup::study(const char* spec, int flags)
+{
+    return std::shared_ptr<const OptionGroup>(new OptionGroup(spec, flags));
+}
+
+std::shared_ptr<const OptionGroup> OptionGroup::study(std::shared_ptr<const SpecFile> file, int flags)
+{
+    return std::shared_ptr<const OptionGroup>(new OptionGroup(std::move(file), flags));
+}
+
+OptionGroup::OptionGroup(const char* spec, int flags) : text(Copy(spec)), cmd(text.get(), flags)
+{
+    materialize();
+}
+
+OptionGroup::OptionGroup(std::shared_ptr<const SpecFile> file, int flags) : cmd(std::move(file), flags)
+{
+    materialize();
+}
+
+// Defaults are materialized here, once, so that nothing in the group changes after
+void OptionGroup::materialize()
+{
+    initial = cmd.values;
+    for (auto& opt : cmd.options)
+        initial[opt.second] = cmd[opt.first.c_str()];
+}
+
+const std::pair<const std::string, int>* OptionGroup::find(const char* b, const char* e) const
+{
+    return cmd.findOption(b, e);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// The group's values go after the parser's own, so that value indices stay dense for
+// bindings, handlers and Results
+void Cmdline::include(std::shared_ptr<const OptionGroup> group)
+{
+    int base = (int) values.size();
+    for (int v = 0; v < group->size(); v++)
+    {
+        values.push_back(group->value(v));
+        initial.push_back(group->value(v));
+    }
+    if (group->failed())
+        failed = true;
+    groups.push_back(Included{ std::move(group), base });
+    parsed.clear();
+}
+
+// Folded names are copied to the stack, which is plenty for any real option name
+const std::pair<const std::string, int>* Cmdline::findOption(const char* b, const char* e) const
+{
+    char folded[256];
+    auto pos = options.end();
+    if (!foldCase)
+        pos = options.find(Fragment(b, e));
+    else if (e - b <= (ptrdiff_t) sizeof(folded))
+    {
+        memcpy(folded, b, e - b);
+        cmdline::foldCase(folded, folded + (e - b));
+        pos = options.find(Fragment(folded, folded + (e - b)));
+    }
+    else
+        pos = options.find(key(b, e));
+    return pos != options.end() ? &*pos : nullptr;
+}
+
+// Look in our own options, then in each group
+int Cmdline::lookup(const char* b, const char* e, const std::string** name) const
+{
+    auto pos = findOption(b, e);
+    if (pos != nullptr)
+    {
+        if (name != nullptr)
+            *name = &pos->first;
+        return pos->second;
+    }
+
+    for (auto& g : groups)
+    {
+        auto entry = g.group->find(b, e);
+        if (entry == nullptr)
+            continue;
+        if (name != nullptr)
+            *name = &entry->first;
+        return g.base + entry->second;
+    }
+    return -1;
+}
+
+bool Cmdline::groupDefault(int v) const
+{
+    for (auto& g : groups)
+        if (v >= g.base && v < g.base + g.group->size())
+            return g.group->hasDefault(v - g.base);
+    return false;
+}
+
+} // namespace cmdline
@@ -0,0 +1,109 @@
+//=================================================================================================
+// keyvalue.cpp
+//  - <key=value> options, collected into sorted tables of views into argv
+//=================================================================================================
+
+#include "cmdline/cmdline.h"
+#include "cmdline/spec.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace cmdline
+{
+
+namespace
+{
+int Compare(const Fragment& a, const char* b, size_t len)
+{
+    size_t alen = a.e - a.b;
+    int c = memcmp(a.b, b, std::min(alen, len));
+    return c != 0 ? c : (alen < len ? -1 : alen > len ? 1 : 0);
+}
+
+bool KeyLess(const KeyValues::Pair& a, const KeyValues::Pair& b)
+{
+    int c = Compare(a.key, b.key.b, b.key.e - b.key.b);
+    return c < 0 || (c == 0 && a.arg < b.arg);
+}
+}
+
+std::pair<const KeyValues::Pair*, const KeyValues::Pair*> KeyValues::all(const char* key) const
+{
+    size_t len = strlen(key);
+    auto lo = std::lower_bound(begin(), end(), len, [key](const Pair& p, size_t l) { return Compare(p.key, key, l) < 0; });
+    auto hi = std::upper_bound(lo, end(), len, [key](size_t l, const Pair& p) { return Compare(p.key, key, l) > 0; });
+    return std::make_pair(lo, hi);
+}
+
+const char* KeyValues::find(const char* key) const
+{
+    auto range = all(key);
+    return range.first != range.second ? range.second[-1].value : nullptr;
+}
+
+const KeyValues* Cmdline::keyValues(const char* option) const
+{
+    if (lazy)
+        const_cast<Cmdline*>(this)->complete();
+    int v = lookup(option);
+    for (auto& table : keyValueTables)
+        if (table.value == v)
+            return &table;
+    return nullptr;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Split each argument of one occurrence at its first '='. An argument without one is a
+// command-line error.
+bool internal::addKeyValues(Cmdline& cmd, int v, const char* option, const char* first, const char* const* rest, int n, int arg)
+{
+    KeyValues* table = nullptr;
+    for (auto& t : cmd.keyValueTables)
+        if (t.value == v)
+            table = &t;
+    if (table == nullptr)
+        return true;
+
+    bool ok = true;
+    for (int k = 0; k < n; k++)
+    {
+        const char* str = k == 0 ? first : rest[k - 1];
+        const char* eq = strchr(str, '=');
+        if (eq == nullptr)
+        {
+            cmd.badArgs = true;
+            cmd.errorMsg += std::string("expected key=value for option ") + option + ": " + str + "\n";
+            ok = false;
+            continue;
+        }
+        table->pairs.push_back(KeyValues::Pair{ Fragment(str, eq), eq + 1, arg + k });
+    }
+    return ok;
+}
+
+// Sort each table by key, keeping argv order for equal keys, and then keep only the
+// last of each key unless the option keeps lists. Pairs are compacted in place, so a
+// table's storage is reused from one eval() to the next.
+void internal::sortKeyValues(Cmdline& cmd)
+{
+    for (auto& table : cmd.keyValueTables)
+    {
+        auto& pairs = table.pairs;
+        std::sort(pairs.begin(), pairs.end(), KeyLess);
+        if (table.list || pairs.empty())
+            continue;
+
+        size_t out = 0;
+        for (size_t i = 0; i < pairs.size(); i++)
+        {
+            bool last = i + 1 == pairs.size() || Compare(pairs[i].key, pairs[i + 1].key.b, pairs[i + 1].key.e - pairs[i + 1].key.b) != 0;
+            if (last)
+                pairs[out++] = pairs[i];
+        }
+        pairs.resize(out);
+    }
+}
+
+} // namespace cmdline
@@ -0,0 +1,199 @@
+//=================================================================================================
+// procscan.cpp
+//  - classifying running processes by parsing their command lines against tool specs
+//=================================================================================================
+
+#include "cmdline/procscan.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cmdline
+{
+
+// A worker's parsers, one per tool
+struct ProcScanner::Worker
+{
+    std::vector<Cmdline> cmds;
+    std::vector<char> buffer;
+};
+
+namespace
+{
+enum { Batch = 64 }; // processes a worker claims at a time
+
+#if !defined(_WIN32)
+// Read a whole file into buffer, leaving a byte spare after it. Returns the length,
+// or -1.
+long ReadAll(const char* path, std::vector<char>& buffer)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    size_t len = 0;
+    for (;;)
+    {
+        if (buffer.size() - len < 2)
+            buffer.resize(std::max(buffer.size() * 2, (size_t) 4096));
+        ssize_t n = read(fd, buffer.data() + len, buffer.size() - len - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            close(fd);
+            return n < 0 ? -1 : (long) len;
+        }
+        len += n;
+    }
+}
+#endif
+}
+
+ProcScanner::ProcScanner(const char* root_) : root(root_), next(0)
+{
+}
+
+ProcScanner::~ProcScanner()
+{
+}
+
+int ProcScanner::add(const char* program, const char* spec, int flags)
+{
+    size_t n = strlen(spec) + 1;
+    Tool tool{ program, std::unique_ptr<char[]>(new char[n]), flags };
+    memcpy(tool.spec.get(), spec, n);
+    tools.push_back(std::move(tool));
+
+    int t = (int) tools.size() - 1;
+    auto pos = std::lower_bound(byName.begin(), byName.end(), t, [this](int a, int b) {
+        return tools[a].program < tools[b].program;
+    });
+    byName.insert(pos, t);
+    workers.clear(); // their parsers don't know this tool
+    return t;
+}
+
+int ProcScanner::find(const char* program, size_t len) const
+{
+    auto pos = std::lower_bound(byName.begin(), byName.end(), len, [this, program](int t, size_t l) {
+        return tools[t].program.compare(0, std::string::npos, program, l) < 0;
+    });
+    if (pos == byName.end() || tools[*pos].program.compare(0, std::string::npos, program, len) != 0)
+        return -1;
+    return *pos;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void ProcScanner::listPids()
+{
+    pids.clear();
+#if !defined(_WIN32)
+    DIR* dir = opendir(root.c_str());
+    if (dir == nullptr)
+        return;
+    while (dirent* entry = readdir(dir))
+    {
+        const char* name = entry->d_name;
+        int pid = 0;
+        for (; *name >= '0' && *name <= '9' && pid < 100000000; name++)
+            pid = pid * 10 + (*name - '0');
+        if (*name == '\0' && name != entry->d_name)
+            pids.push_back(pid);
+    }
+    closedir(dir);
+#endif
+}
+
+int ProcScanner::scan(const Visitor& visit, int threads)
+{
+    listPids();
+    if (threads <= 0)
+        threads = std::max((int) std::thread::hardware_concurrency(), 1);
+    threads = std::max(std::min(threads, ((int) pids.size() + Batch - 1) / Batch), 1);
+
+    // Workers are made on first use, and kept with their buffers for later scans. The
+    // first one reports the tools' spec errors, so they're gathered afresh each time
+    // add() has thrown the workers away.
+    if (workers.empty())
+        specErrors.clear();
+    while ((int) workers.size() < threads)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        for (auto& tool : tools)
+        {
+            worker->cmds.emplace_back(tool.spec.get(), tool.flags);
+            if (workers.empty() && worker->cmds.back().failed)
+                specErrors += tool.program + ": " + worker->cmds.back().errorMsg;
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    next = 0;
+    std::vector<int> counts(threads, 0);
+    std::vector<std::thread> pool;
+    for (int w = 1; w < threads; w++)
+        pool.emplace_back([&, w]() { counts[w] = run(*workers[w], visit); });
+    counts[0] = run(*workers[0], visit);
+    for (auto& t : pool)
+        t.join();
+
+    int parsed = 0;
+    for (int n : counts)
+        parsed += n;
+    return parsed;
+}
+
+// Claim batches of pids until there are none left
+int ProcScanner::run(Worker& worker, const Visitor& visit)
+{
+    int parsed = 0;
+#if !defined(_WIN32)
+    char path[4096];
+    for (;;)
+    {
+        int b = next.fetch_add(Batch);
+        if (b >= (int) pids.size())
+            break;
+        int e = std::min(b + (int) Batch, (int) pids.size());
+        for (int i = b; i < e; i++)
+        {
+            snprintf(path, sizeof(path), "%s/%d/cmdline", root.c_str(), pids[i]);
+            long len = ReadAll(path, worker.buffer);
+            if (len <= 0)
+                continue;
+
+            // The program is argv[0] up to its first nul, without its directory
+            char* args = worker.buffer.data();
+            const char* end = args;
+            const char* program = args;
+            for (; end < args + len && *end != '\0'; end++)
+                if (*end == '/')
+                    program = end + 1;
+            int t = find(program, end - program);
+            if (t < 0 || worker.cmds[t].failed)
+                continue;
+
+            Cmdline& cmd = worker.cmds[t];
+            cmd.eval(args, len);
+            visit(Process{ pids[i], t, &cmd });
+            parsed += 1;
+        }
+    }
+#else
+    (void) worker;
+    (void) visit;
+#endif
+    return parsed;
+}
+
+} // namespace cmdline
@@ -0,0 +1,100 @@
+//=================================================================================================
+// registry.cpp
+//  - spec fragments declared across translation units and merged on first use
+//=================================================================================================
+
+#include "cmdline/registry.h"
+#include "cmdline/spec.h"
+#include "cmdline/utf8.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace cmdline
+{
+
+namespace
+{
+// Constant-initialized, so fragments can register from any static constructor
+SpecRegistry globalRegistry;
+
+// Collects every name a spec declares, spelled the way a user would type it, to find
+// the ones declared twice
+class NameSink : public internal::SpecSink
+{
+public:
+    int value(bool named) override { (void) named; return numValues++; }
+    bool positional(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        (void) v; (void) minArgs; (void) maxArgs;
+        names.push_back("<" + std::string(name.b, name.e) + ">");
+        return true;
+    }
+    bool named(Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        (void) v; (void) minArgs; (void) maxArgs;
+        names.push_back((utf8Length(name.b, name.e) == 1 ? "-" : "--") + std::string(name.b, name.e));
+        return true;
+    }
+
+    std::vector<std::string> names;
+    int numValues = 0;
+};
+}
+
+SpecFragment::SpecFragment(const char* text, SpecRegistry& registry) : spec(text), link(nullptr)
+{
+    registry.push(this);
+}
+
+SpecFragment::SpecFragment(const char* text) : SpecFragment(text, SpecRegistry::global())
+{
+}
+
+SpecRegistry& SpecRegistry::global()
+{
+    return globalRegistry;
+}
+
+void SpecRegistry::push(SpecFragment* fragment)
+{
+    SpecFragment* old = head.load(std::memory_order_relaxed);
+    do
+        fragment->link = old;
+    while (!head.compare_exchange_weak(old, fragment, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// The list is newest first, so it's reversed to get registration order. Fragments are
+// joined with blank lines, so a usage section in one doesn't run into the next.
+std::shared_ptr<const OptionGroup> SpecRegistry::merged()
+{
+    std::call_once(once, [this]() {
+        std::vector<const char*> texts;
+        for (const SpecFragment* f = first(); f != nullptr; f = f->next())
+            texts.push_back(f->text());
+        std::reverse(texts.begin(), texts.end());
+
+        std::string spec;
+        for (auto text : texts)
+            spec.append(text).append("\n\n");
+
+        std::shared_ptr<OptionGroup> studied(new OptionGroup(spec.c_str(), 0));
+
+        NameSink sink;
+        internal::study(spec.data(), spec.data() + spec.size(), sink);
+        std::sort(sink.names.begin(), sink.names.end());
+        for (size_t i = 1; i < sink.names.size(); i++)
+        {
+            if (sink.names[i] != sink.names[i - 1] || (i > 1 && sink.names[i - 1] == sink.names[i - 2]))
+                continue;
+            studied->cmd.errorMsg += "option declared more than once: " + sink.names[i] + "\n";
+            studied->cmd.failed = true;
+        }
+
+        group = std::move(studied);
+    });
+    return group;
+}
+
+} // namespace cmdline
@@ -0,0 +1,404 @@
+//=================================================================================================
+// result.cpp
+//  - immutable, shareable parse results
+//=================================================================================================
+
+#include "cmdline/result.h"
+#include "cmdline/group.h"
+#include "cmdline/utf8.h"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cmdline
+{
+
+std::shared_ptr<const Result> Cmdline::freeze() const
+{
+    if (lazy)
+        const_cast<Cmdline*>(this)->complete();
+    return std::make_shared<const Result>(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace
+{
+// Accumulates strings for the packed block and hands back their final offsets
+class StringPool
+{
+public:
+    explicit StringPool(uint32_t base_) : base(base_) {}
+
+    uint32_t add(const char* s)
+    {
+        if (s == nullptr)
+            return 0;
+        uint32_t offset = base + (uint32_t) pool.size();
+        pool.append(s, strlen(s) + 1);
+        return offset;
+    }
+
+    const std::string& bytes() const { return pool; }
+
+private:
+    uint32_t base;
+    std::string pool;
+};
+}
+
+// Pack the Cmdline into a single block. There are two passes, one to size the fixed
+// part, and one to fill it in once the string pool has been assigned offsets.
+Result::Result(const Cmdline& cmd)
+{
+    // The options sorted by name, which is what lookups binary search on. Names from
+    // included groups are merged in, with the parser's own names (and earlier groups)
+    // hiding later ones, as in Cmdline::lookup.
+    typedef std::pair<const std::string*, int> Named;
+    std::vector<Named> names;
+    for (auto& opt : cmd.options)
+        names.push_back(Named{ &opt.first, opt.second });
+    for (auto& g : cmd.groups)
+        for (auto& opt : g.group->names())
+            names.push_back(Named{ &opt.first, g.base + opt.second });
+    auto byName = [](const Named& a, const Named& b) { return *a.first < *b.first; };
+    std::stable_sort(names.begin(), names.end(), byName);
+    names.erase(std::unique(names.begin(), names.end(), [](const Named& a, const Named& b) { return *a.first == *b.first; }), names.end());
+
+    uint32_t numOptions = (uint32_t) names.size();
+    uint32_t numPositionals = (uint32_t) cmd.positionals.size();
+    uint32_t numRest = 0;
+    for (auto& v : cmd.values)
+        numRest += v.count() > 1 ? v.count() - 1 : 0;
+    uint32_t restStart = sizeof(Header) + numOptions * sizeof(Entry) + numPositionals * sizeof(uint32_t);
+    uint32_t fixedSize = restStart + numRest * sizeof(uint32_t);
+
+    StringPool pool(fixedSize);
+    std::vector<Entry> entries;
+    entries.reserve(numOptions);
+
+    // Values shared by synonyms have their extra arguments added to the pool once
+    std::vector<uint32_t> rest;
+    std::vector<uint32_t> restOf(cmd.values.size(), 0);
+
+    for (auto& opt : names)
+    {
+        Entry e;
+        e.name = pool.add(opt.first->c_str());
+        auto& v = cmd.values[opt.second];
+
+        // An option that wasn't given keeps its default from the spec, if it has one
+        internal::Defaults::Entry* d = v.exists() || !cmd.defaults ? nullptr : cmd.defaults->find(opt.second);
+        e.str = pool.add(d != nullptr ? cmd.defaults->materialize(*d, v).string() : v.string());
+        e.nargs = v.nargs();
+        e.maxArgs = v.maxArgs();
+        e.count = v.count();
+        e.rest = 0;
+        e.flags = v.exists() ? (uint32_t) EntryExists : 0;
+        e.reserved = 0;
+        if (v.count() > 1)
+        {
+            if (restOf[opt.second] == 0)
+            {
+                restOf[opt.second] = restStart + (uint32_t) rest.size() * sizeof(uint32_t);
+                for (int i = 1; i < v.count(); i++)
+                    rest.push_back(pool.add(v.arg(i)));
+            }
+            e.rest = restOf[opt.second];
+        }
+        entries.push_back(e);
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(numPositionals);
+    for (auto& name : cmd.positionals)
+        order.push_back((uint32_t) std::distance(names.begin(), std::lower_bound(names.begin(), names.end(), Named{ &name, 0 }, byName)));
+
+    Header h;
+    h.magic = Magic;
+    h.numOptions = numOptions;
+    h.numPositionals = numPositionals;
+    h.usage = pool.add(cmd.usage().c_str());
+    h.errors = pool.add(cmd.errorMsg.c_str());
+    h.flags = (cmd.failed ? (uint32_t) ResultFailed : 0) | (cmd.badArgs ? (uint32_t) ResultBadArgs : 0)
+        | (cmd.foldCase ? (uint32_t) ResultFoldCase : 0);
+    h.numRest = numRest;
+
+    blobSize = fixedSize + pool.bytes().size();
+    h.size = (uint32_t) blobSize;
+    blob.reset(new char[blobSize]);
+    base = blob.get();
+
+    char* p = blob.get();
+    memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    memcpy(p, entries.data(), numOptions * sizeof(Entry));
+    p += numOptions * sizeof(Entry);
+    memcpy(p, order.data(), numPositionals * sizeof(uint32_t));
+    p += numPositionals * sizeof(uint32_t);
+    if (numRest != 0)
+        memcpy(p, rest.data(), numRest * sizeof(uint32_t));
+    p += numRest * sizeof(uint32_t);
+    memcpy(p, pool.bytes().data(), pool.bytes().size());
+
+    link();
+}
+
+// Turn the offsets of extra arguments into pointers. Each entry's rest array is
+// mirrored at the same index in restPointers.
+void Result::link()
+{
+    if (header().numRest == 0)
+        return;
+
+    auto b = entries();
+    auto e = b + header().numOptions;
+    uint32_t restStart = (uint32_t) ((const char*) (positionalEntries() + header().numPositionals) - base);
+
+    for (auto entry = b; entry != e; entry++)
+    {
+        for (uint32_t i = 1; i < entry->count; i++)
+        {
+            uint32_t k = (entry->rest - restStart) / sizeof(uint32_t) + i - 1;
+            if (restPointers.size() <= k)
+                restPointers.resize(k + 1);
+            restPointers[k] = string(reinterpret_cast<const uint32_t*>(base + entry->rest)[i - 1]);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Check a block before reading anything from it: the header has to agree with the size,
+// and every offset in it has to land inside the block. Strings are nul-terminated and
+// the block has to end in a nul, so a string that starts inside it can't be read past
+// its end. This is linear in the number of entries and extra arguments, since each of
+// their offsets is checked.
+bool Result::check(const void* data, size_t size)
+{
+    if (data == nullptr || size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % 4 != 0)
+        return false;
+
+    auto& h = *static_cast<const Header*>(data);
+    uint64_t restStart = sizeof(Header) + (uint64_t) h.numOptions * sizeof(Entry) + (uint64_t) h.numPositionals * sizeof(uint32_t);
+    uint64_t fixed = restStart + (uint64_t) h.numRest * sizeof(uint32_t);
+    if (h.magic != Magic || h.size != size || fixed > size)
+        return false;
+    if (size != fixed && static_cast<const char*>(data)[size - 1] != '\0')
+        return false;
+
+    // A string is either null (offset 0), or starts in the string pool after the fixed part
+    auto validString = [fixed, size](uint32_t offset, bool nullable) {
+        return offset == 0 ? nullable : offset >= fixed && offset < size;
+    };
+    if (!validString(h.usage, true) || !validString(h.errors, true))
+        return false;
+
+    auto entries = reinterpret_cast<const Entry*>(static_cast<const char*>(data) + sizeof(Header));
+    auto rest = reinterpret_cast<const uint32_t*>(static_cast<const char*>(data) + restStart);
+    for (uint32_t k = 0; k < h.numOptions; k++)
+    {
+        const Entry& e = entries[k];
+        if (!validString(e.name, false) || !validString(e.str, true))
+            return false;
+        if (e.count <= 1)
+            continue;
+
+        // The count - 1 offsets of the extra arguments are a run of the rest array
+        if (e.rest < restStart || (e.rest - restStart) % sizeof(uint32_t) != 0
+            || e.rest + (uint64_t) (e.count - 1) * sizeof(uint32_t) > fixed)
+            return false;
+        for (uint32_t i = 0; i < e.count - 1; i++)
+            if (!validString(rest[(e.rest - restStart) / sizeof(uint32_t) + i], false))
+                return false;
+    }
+
+    auto order = reinterpret_cast<const uint32_t*>(entries + h.numOptions);
+    for (uint32_t k = 0; k < h.numPositionals; k++)
+        if (order[k] >= h.numOptions)
+            return false;
+    return true;
+}
+
+Result::Result(const char* data, size_t size, std::shared_ptr<const void> keep)
+    : mapped(std::move(keep)), base(data), blobSize(size)
+{
+    link();
+}
+
+std::shared_ptr<const Result> Result::adopt(const void* data, size_t size)
+{
+    if (!check(data, size))
+        return nullptr;
+    return std::shared_ptr<const Result>(new Result(static_cast<const char*>(data), size, nullptr));
+}
+
+namespace
+{
+bool ReadAll(int fd, char* p, size_t n)
+{
+    while (n > 0)
+    {
+#if defined(_WIN32)
+        int got = _read(fd, p, (unsigned int) n);
+#else
+        ssize_t got = read(fd, p, n);
+        if (got < 0 && errno == EINTR)
+            continue;
+#endif
+        if (got <= 0)
+            return false;
+        p += got;
+        n -= (size_t) got;
+    }
+    return true;
+}
+}
+
+// Map the whole file if it is one. Otherwise read the header to find the size, and
+// then the rest into a buffer of our own.
+std::shared_ptr<const Result> Result::map(int fd)
+{
+#if !defined(_WIN32)
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= (off_t) sizeof(Header))
+    {
+        size_t size = (size_t) st.st_size;
+        void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            if (!check(p, size))
+            {
+                munmap(p, size);
+                return nullptr;
+            }
+            std::shared_ptr<const void> keep(p, [size](const void* m) { munmap(const_cast<void*>(m), size); });
+            return std::shared_ptr<const Result>(new Result(static_cast<const char*>(p), size, std::move(keep)));
+        }
+    }
+#endif
+
+    Header h;
+    if (!ReadAll(fd, reinterpret_cast<char*>(&h), sizeof(h)) || h.magic != Magic || h.size < sizeof(h))
+        return nullptr;
+    std::shared_ptr<char> copy(new char[h.size], std::default_delete<char[]>());
+    memcpy(copy.get(), &h, sizeof(h));
+    if (!ReadAll(fd, copy.get() + sizeof(h), h.size - sizeof(h)) || !check(copy.get(), h.size))
+        return nullptr;
+    const char* data = copy.get();
+    return std::shared_ptr<const Result>(new Result(data, h.size, std::move(copy)));
+}
+
+bool Result::write(int fd) const
+{
+    const char* p = base;
+    size_t n = blobSize;
+    while (n > 0)
+    {
+#if defined(_WIN32)
+        int put = _write(fd, p, (unsigned int) n);
+#else
+        ssize_t put = ::write(fd, p, n);
+        if (put < 0 && errno == EINTR)
+            continue;
+#endif
+        if (put <= 0)
+            return false;
+        p += put;
+        n -= (size_t) put;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+const Result::Header& Result::header() const
+{
+    return *reinterpret_cast<const Header*>(base);
+}
+
+const Result::Entry* Result::entries() const
+{
+    return reinterpret_cast<const Entry*>(base + sizeof(Header));
+}
+
+const uint32_t* Result::positionalEntries() const
+{
+    return reinterpret_cast<const uint32_t*>(entries() + header().numOptions);
+}
+
+const char* Result::string(uint32_t offset) const
+{
+    return offset == 0 ? nullptr : base + offset;
+}
+
+Value Result::operator[](const char* option) const
+{
+    std::string folded;
+    if ((header().flags & ResultFoldCase) != 0)
+    {
+        folded = option;
+        foldCase(&folded[0], &folded[0] + folded.size());
+        option = folded.c_str();
+    }
+
+    auto b = entries();
+    auto e = b + header().numOptions;
+    auto pos = std::lower_bound(b, e, option, [this](const Entry& entry, const char* name) {
+        return strcmp(string(entry.name), name) < 0;
+    });
+
+    // As with Cmdline, asking for an option not in the spec is a caller error
+    if (pos == e || strcmp(string(pos->name), option) != 0)
+        return Value();
+
+    Value v(string(pos->str), (pos->flags & EntryExists) != 0);
+    v.arity(pos->nargs, pos->maxArgs);
+    if (pos->count > 1)
+    {
+        uint32_t restStart = (uint32_t) ((const char*) (positionalEntries() + header().numPositionals) - base);
+        v.set(v.string(), &restPointers[(pos->rest - restStart) / sizeof(uint32_t)], pos->count);
+    }
+    return v;
+}
+
+const char* Result::usage() const
+{
+    return string(header().usage);
+}
+
+const char* Result::errors() const
+{
+    return string(header().errors);
+}
+
+bool Result::failed() const
+{
+    return (header().flags & ResultFailed) != 0;
+}
+
+bool Result::badArgs() const
+{
+    return (header().flags & ResultBadArgs) != 0;
+}
+
+int Result::positionals() const
+{
+    return (int) header().numPositionals;
+}
+
+const char* Result::positional(int i) const
+{
+    return string(entries()[positionalEntries()[i]].name);
+}
+
+} // namespace cmdline
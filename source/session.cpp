@@ -0,0 +1,355 @@
+//=================================================================================================
+// session.cpp
+//  - incremental re-parsing of a line as it's edited
+//=================================================================================================
+
+#include "cmdline/session.h"
+#include "cmdline/group.h"
+#include "cmdline/spec.h"
+#include "cmdline/utf8.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace cmdline
+{
+
+namespace
+{
+char programName[] = "";
+
+bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+}
+
+// The option names are looked up without building strings, so they're kept sorted in
+// the same order as the Cmdline's map, along with the names from its groups that
+// aren't hidden by its own
+Session::Session(Cmdline& cmd_, size_t reserve) : cmd(cmd_), numReparsed(0)
+{
+    for (auto& opt : cmd.options)
+        names.push_back(Name{ opt.first.c_str(), opt.first.size(), opt.second });
+    for (auto& g : cmd.groups)
+        for (auto& opt : g.group->names())
+            if (cmd.lookup(opt.first.c_str()) == g.base + opt.second)
+                names.push_back(Name{ opt.first.c_str(), opt.first.size(), g.base + opt.second });
+    std::sort(names.begin(), names.end(), [](const Name& a, const Name& b) {
+        int c = memcmp(a.name, b.name, std::min(a.len, b.len));
+        return c < 0 || (c == 0 && a.len < b.len);
+    });
+    for (auto& name : cmd.positionals)
+        positionalValues.push_back(cmd.options.find(name)->second);
+    counts.assign(cmd.actions ? cmd.values.size() : 0, Count{ 0, {} });
+
+    text.reserve(reserve);
+    tokens.reserve(reserve + 1);
+    args.reserve(reserve / 2 + 1);
+    ends.reserve(reserve / 2 + 1);
+    stepOf.reserve(reserve / 2 + 1);
+    steps.reserve(reserve / 2 + 1);
+    undo.reserve(reserve / 2 + 1);
+
+    args.push_back(programName);
+    ends.push_back(0);
+    stepOf.push_back(-1);
+    state = State{ 0, false, nullptr, -1 };
+}
+
+void Session::update(const char* line, size_t len)
+{
+    size_t common = 0;
+    size_t n = std::min(len, text.size());
+    while (common < n && text[common] == line[common])
+        common++;
+    if (common == len && common == text.size())
+    {
+        numReparsed = 0;
+        return;
+    }
+
+    text.resize(common);
+    text.insert(text.end(), line + common, line + len);
+    reparse(common);
+}
+
+void Session::edit(size_t at, size_t erase, const char* more, size_t len)
+{
+    at = std::min(at, text.size());
+    erase = std::min(erase, text.size() - at);
+    text.erase(text.begin() + at, text.begin() + at + erase);
+    text.insert(text.begin() + at, more, more + len);
+    reparse(at);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Undo the steps an edit at byte offset from can have affected, and parse again from
+// there. Anything that moves the storage the values point into (argv strings, or argv
+// itself) means starting over, but that only happens while the line is still growing
+// past the longest one seen.
+void Session::reparse(size_t from)
+{
+    // The first argument that changed is the first one that doesn't end before the edit;
+    // the step it's in, or the one before if that looked ahead at it, is where to resume
+    int k = 1;
+    while (k < (int) args.size() && ends[k] < from)
+        k++;
+    size_t s = k > 1 ? stepOf[k - 1] : 0;
+    if (s < steps.size() && steps[s].last < k)
+        s += 1;
+
+    bool moved = text.size() + 1 > tokens.capacity();
+    if (moved)
+        s = 0;
+
+    // Put back the values the undone steps overwrote, newest first
+    int start = s < steps.size() ? steps[s].arg : k;
+    size_t keep = s < steps.size() ? steps[s].undo : undo.size();
+    if (s < steps.size())
+        state = steps[s].state;
+    if (moved)
+        start = 1;
+    while (undo.size() > keep)
+        undoLast();
+    steps.resize(std::min(s, steps.size()));
+
+    char* const* before = args.data();
+    tokenize(start);
+    if (args.data() != before)
+    {
+        // Values of the kept steps point into the old argv
+        while (!undo.empty())
+            undoLast();
+        steps.clear();
+        state = State{ 0, false, nullptr, -1 };
+        start = 1;
+    }
+
+    for (int i = start; i < (int) args.size(); )
+        i = parseStep(i);
+    numReparsed = (int) args.size() - start;
+}
+
+// Split the line from argument start on, turning whitespace into nuls. The arguments
+// before start are unchanged, and so is their place in tokens.
+void Session::tokenize(int start)
+{
+    size_t from = start > 1 ? ends[start - 1] : 0;
+
+    tokens.resize(text.size() + 1);
+    for (size_t b = from; b < text.size(); b++)
+        tokens[b] = IsSpace(text[b]) ? '\0' : text[b];
+    tokens[text.size()] = '\0';
+
+    args.resize(start);
+    ends.resize(start);
+    stepOf.resize(start);
+    for (size_t p = from; p < text.size(); )
+    {
+        if (tokens[p] == '\0')
+        {
+            p++;
+            continue;
+        }
+        size_t b = p;
+        while (tokens[p] != '\0')
+            p++;
+        args.push_back(&tokens[b]);
+        ends.push_back(p);
+        stepOf.push_back(-1);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int Session::lookup(const char* name, size_t len) const
+{
+    // Folded names are copied to the stack, which is plenty for any real option name
+    char folded[256];
+    if (cmd.foldCase)
+    {
+        if (len > sizeof(folded))
+            return -1;
+        memcpy(folded, name, len);
+        foldCase(folded, folded + len);
+        name = folded;
+    }
+
+    auto pos = std::lower_bound(names.begin(), names.end(), len, [name](const Name& n, size_t l) {
+        int c = memcmp(n.name, name, std::min(n.len, l));
+        return c < 0 || (c == 0 && n.len < l);
+    });
+    if (pos == names.end() || pos->len != len || memcmp(pos->name, name, len) != 0)
+        return -1;
+    return pos->value;
+}
+
+// The same test as eval() uses: a known option, or "--"
+bool Session::isOption(const char* arg) const
+{
+    if (arg[0] != '-' || arg[1] == '\0')
+        return false;
+    const char* opt = arg + 1;
+    if (*opt == '-') opt++;
+    if (*opt == '\0')
+        return true;
+    const char* eq = strchr(opt, '=');
+    return lookup(opt, eq != nullptr ? eq - opt : strlen(opt)) >= 0;
+}
+
+void Session::assign(int v, const Value& value)
+{
+    undo.push_back(Undo{ v, cmd.values[v], v < (int) counts.size() ? counts[v].n : 0 });
+    cmd.values[v] = value;
+}
+
+// A counted flag's previous value points at its digits, so they're put back too
+void Session::undoLast()
+{
+    const Undo& u = undo.back();
+    cmd.values[u.value] = u.previous;
+    if (u.value < (int) counts.size() && counts[u.value].n != u.count)
+    {
+        counts[u.value].n = u.count;
+        snprintf(counts[u.value].digits, sizeof(counts[u.value].digits), "%d", u.count);
+    }
+    undo.pop_back();
+}
+
+// A flag is set by its action, as eval() sets it. A count goes up by one.
+void Session::setFlag(int v)
+{
+    Value value = cmd.values[v];
+    if (cmd.actions && cmd.actions->code(v) == internal::Actions::Count)
+    {
+        Count& count = counts[v];
+        snprintf(count.digits, sizeof(count.digits), "%d", count.n + 1);
+        value.set(count.digits);
+        assign(v, value);
+        count.n += 1;
+        return;
+    }
+    value.set(internal::flagValue(cmd, v));
+    assign(v, value);
+}
+
+// Split a cluster of short options, like -vvv or -xzf, the way eval() does: every code
+// point but the last has to be a flag, and those are set here, and the last is returned
+// to take any arguments after it. Returns -1, having done nothing, if it isn't one.
+int Session::cluster(const char* opt)
+{
+    const char* last = nullptr;
+    for (const char* p = opt; *p != '\0'; )
+    {
+        const char* e = p + 1;
+        while ((*e & 0xc0) == 0x80)
+            e++;
+        int v = lookup(p, e - p);
+        if (v < 0 || (*e != '\0' && cmd.values[v].maxArgs() != 0))
+            return -1;
+        last = p;
+        p = e;
+    }
+    if (last == nullptr || last == opt)
+        return -1;
+
+    for (const char* p = opt; p != last; )
+    {
+        const char* e = p + 1;
+        while ((*e & 0xc0) == 0x80)
+            e++;
+        setFlag(lookup(p, e - p));
+        p = e;
+    }
+    return lookup(last, strlen(last));
+}
+
+// Parse one step starting at argument i: an option and its arguments, "--", or a
+// positional. Returns the argument after the step.
+int Session::parseStep(int i)
+{
+    steps.push_back(Step{ i, i, undo.size(), state });
+    Step& step = steps.back();
+    stepOf[i] = (int) steps.size() - 1;
+
+    auto fail = [this](const char* message, int arg) {
+        if (state.error == nullptr)
+        {
+            state.error = message;
+            state.errorArg = arg;
+        }
+    };
+
+    // Take arguments after i for a value, up to max of them, stopping at options. If it
+    // stops short of max, it depended on the next argument, even if there isn't one yet.
+    int argc = (int) args.size();
+    auto take = [&](int n, int max) {
+        while (n < max && i + 1 < argc && (state.optionsEnded || !isOption(args[i + 1])))
+        {
+            i += 1;
+            n += 1;
+            stepOf[i] = stepOf[step.arg];
+        }
+        step.last = n < max ? i + 1 : i;
+        return n;
+    };
+
+    char* arg = args[i];
+    if (!state.optionsEnded && strcmp(arg, "--") == 0)
+    {
+        state.optionsEnded = true;
+        return i + 1;
+    }
+
+    if (state.optionsEnded || arg[0] != '-' || arg[1] == '\0')
+    {
+        if (state.positional >= (int) positionalValues.size())
+        {
+            fail("unexpected argument", i);
+            return i + 1;
+        }
+        int v = positionalValues[state.positional++];
+        int at = i;
+        int n = take(1, cmd.values[v].maxArgs());
+        Value value = cmd.values[v];
+        value.set(args[at], &args[at + 1], n);
+        assign(v, value);
+        return i + 1;
+    }
+
+    const char* opt = arg + 1;
+    if (*opt == '-') opt++;
+    const char* eq = strchr(opt, '=');
+    int v = lookup(opt, eq != nullptr ? eq - opt : strlen(opt));
+    if (v < 0 && eq == nullptr && arg[1] != '-')
+        v = cluster(opt);
+    if (v < 0)
+    {
+        fail("unknown option", i);
+        return i + 1;
+    }
+
+    Value value = cmd.values[v];
+    if (value.maxArgs() == 0)
+    {
+        setFlag(v);
+        return i + 1;
+    }
+
+    int at = i;
+    int n = take(eq != nullptr ? 1 : 0, value.maxArgs());
+    if (n < value.nargs())
+        fail("missing value for option", at);
+    if (n > 0)
+    {
+        const char* first = eq != nullptr ? eq + 1 : args[at + 1];
+        value.set(first, eq != nullptr ? &args[at + 1] : &args[at + 2], n);
+        assign(v, value);
+    }
+    return i + 1;
+}
+
+} // namespace cmdline
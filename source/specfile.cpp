@@ -0,0 +1,107 @@
+//=================================================================================================
+// specfile.cpp
+//  - specs read from files, mapped rather than copied
+//=================================================================================================
+
+#include "cmdline/specfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cmdline
+{
+
+namespace
+{
+#if defined(_WIN32)
+int Open(const char* path) { return _open(path, _O_RDONLY | _O_BINARY); }
+int Close(int fd) { return _close(fd); }
+#else
+int Open(const char* path) { return ::open(path, O_RDONLY | O_CLOEXEC); }
+int Close(int fd) { return ::close(fd); }
+#endif
+
+// Read to the end of the file, for things that can't be mapped
+bool ReadToEnd(int fd, std::vector<char>& buffer)
+{
+    size_t used = 0;
+    for (;;)
+    {
+        if (buffer.size() - used < 4096)
+            buffer.resize(buffer.size() * 2 + 4096);
+#if defined(_WIN32)
+        int got = _read(fd, buffer.data() + used, (unsigned int) (buffer.size() - used));
+#else
+        ssize_t got = read(fd, buffer.data() + used, buffer.size() - used);
+        if (got < 0 && errno == EINTR)
+            continue;
+#endif
+        if (got < 0)
+            return false;
+        if (got == 0)
+            break;
+        used += (size_t) got;
+    }
+    buffer.resize(used);
+    return true;
+}
+}
+
+SpecFile::SpecFile(const char* text_, size_t len_, std::shared_ptr<const void> keep_, bool isMapped_)
+    : text(text_), len(len_), keep(std::move(keep_)), isMapped(isMapped_)
+{
+}
+
+std::shared_ptr<const SpecFile> SpecFile::open(const char* path)
+{
+    return load(path, true);
+}
+
+std::shared_ptr<const SpecFile> SpecFile::read(const char* path)
+{
+    return load(path, false);
+}
+
+// Map the file if it's a regular one with something in it (and mapping is wanted).
+// Otherwise read it into a buffer of our own.
+std::shared_ptr<const SpecFile> SpecFile::load(const char* path, bool map)
+{
+    int fd = Open(path);
+    if (fd < 0)
+        return nullptr;
+
+#if !defined(_WIN32)
+    struct stat st;
+    if (map && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        size_t size = (size_t) st.st_size;
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            Close(fd);
+            std::shared_ptr<const void> keep(p, [size](const void* m) { munmap(const_cast<void*>(m), size); });
+            return std::shared_ptr<const SpecFile>(new SpecFile(static_cast<const char*>(p), size, std::move(keep), true));
+        }
+    }
+#endif
+
+    auto buffer = std::make_shared<std::vector<char>>();
+    bool ok = ReadToEnd(fd, *buffer);
+    Close(fd);
+    if (!ok)
+        return nullptr;
+    const char* text = buffer->empty() ? "" : buffer->data();
+    size_t len = buffer->size();
+    return std::shared_ptr<const SpecFile>(new SpecFile(text, len, std::move(buffer), false));
+}
+
+} // namespace cmdline
@@ -0,0 +1,102 @@
+//=================================================================================================
+// stream.cpp
+//  - stream arguments from a file descriptor, xargs -0 style
+//=================================================================================================
+
+#include "cmdline/stream.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace cmdline
+{
+
+namespace
+{
+int ReadSome(int fd, char* p, size_t n)
+{
+#if defined(_WIN32)
+    return _read(fd, p, (unsigned int) n);
+#else
+    return (int) read(fd, p, n);
+#endif
+}
+}
+
+// The buffer has one extra byte so that a final argument without a trailing
+// delimiter can still be nul-terminated
+ArgStream::ArgStream(int fd_, char delim_, size_t bufferSize)
+    : fd(fd_), delim(delim_), buf(new char[bufferSize + 1]), cap(bufferSize)
+    , begin(0), end(0), eof(false), err(false)
+{
+}
+
+const char* ArgStream::next()
+{
+    for (;;)
+    {
+        if (err)
+            return nullptr;
+
+        // Hand out the next complete argument, terminating it in place
+        char* b = buf.get() + begin;
+        char* d = (char*) memchr(b, delim, end - begin);
+        if (d != nullptr)
+        {
+            *d = '\0';
+            begin = d + 1 - buf.get();
+            return b;
+        }
+
+        // At the end of input, whatever is left is the last argument
+        if (eof)
+        {
+            if (begin == end)
+                return nullptr;
+            buf[end] = '\0';
+            begin = end;
+            return b;
+        }
+
+        if (!fill())
+            return nullptr;
+    }
+}
+
+// Move the partial argument to the front of the buffer and read more after it
+bool ArgStream::fill()
+{
+    if (begin > 0)
+    {
+        memmove(buf.get(), buf.get() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+
+    // A full buffer is only an error if the argument goes on. Probe one byte into the
+    // spare byte at the end: nothing means it was the last argument, and a delimiter
+    // means it fitted exactly.
+    bool full = end == cap;
+    int n;
+    do
+        n = ReadSome(fd, buf.get() + end, full ? 1 : cap - end);
+    while (n < 0 && errno == EINTR);
+
+    if (n < 0 || (full && n == 1 && buf[cap] != delim))
+    {
+        err = true; // a read error, or an argument longer than the buffer
+        return false;
+    }
+    if (n == 0)
+        eof = true;
+    end += n;
+    return true;
+}
+
+} // namespace cmdline
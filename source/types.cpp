@@ -0,0 +1,289 @@
+//=================================================================================================
+// types.cpp
+//  - converters for typed option values
+//=================================================================================================
+
+#include "cmdline/types.h"
+#include "cmdline/spec.h"
+#include "cmdline/utf8.h"
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cmdline
+{
+
+namespace
+{
+bool Less(const std::string& name, const char* b, size_t len)
+{
+    int c = memcmp(name.data(), b, std::min(name.size(), len));
+    return c < 0 || (c == 0 && name.size() < len);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Digits are parsed eight at a time within a 64-bit word (SWAR), which needs the
+// first character in the low byte
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const bool SwarDigits = false;
+#else
+const bool SwarDigits = true;
+#endif
+
+const uint64_t Pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+int LowestBit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int) index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// How many of the eight characters in chunk are digits before the first that isn't.
+// A byte is a digit if subtracting '0' doesn't borrow and adding 0x46 doesn't reach
+// 0x80; a borrow or carry only affects the bytes after the one that caused it.
+int DigitRun(uint64_t chunk)
+{
+    uint64_t nondigit = ((chunk - 0x3030303030303030ull) | (chunk + 0x4646464646464646ull)) & 0x8080808080808080ull;
+    return nondigit == 0 ? 8 : LowestBit(nondigit) / 8;
+}
+
+// The value of the first n (1 to 8) digits of chunk. Shifting the others out leaves
+// zero bytes in front, which count as leading zeros; then pairs of digits, pairs of
+// pairs and pairs of those are combined with three multiplies.
+uint64_t DigitValue(uint64_t chunk, int n)
+{
+    chunk <<= 8 * (8 - n);
+    chunk = (chunk & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    chunk = (chunk & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return (chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32;
+}
+
+// Parse an optionally negative integer at p, returning the end of it, or null with bad
+// set if there isn't one or it doesn't fit in a T
+template<typename T>
+const char* ParseNumber(const char* p, const char* end, T& out, const char** bad)
+{
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+
+    uint64_t n = 0;
+    int digits = 0;
+    while (SwarDigits && end - p >= 8 && digits <= 19)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        int run = DigitRun(chunk);
+        if (run == 0)
+            break;
+        n = n * Pow10[run] + DigitValue(chunk, run);
+        digits += run;
+        p += run;
+        if (run < 8)
+            break;
+    }
+    if (!SwarDigits || end - p < 8)
+    {
+        for (; p < end && *p >= '0' && *p <= '9' && digits <= 19; p++, digits++)
+            n = n * 10 + (*p - '0');
+    }
+
+    // More than 19 digits could have wrapped, and wouldn't fit anyway
+    uint64_t limit = negative ? uint64_t(std::numeric_limits<T>::max()) + 1 : uint64_t(std::numeric_limits<T>::max());
+    if (digits == 0 || digits > 19 || n > limit)
+    {
+        *bad = digits == 0 ? p : start;
+        return nullptr;
+    }
+    out = negative ? T(-(long long) (n - 1) - 1) : T(n);
+    return p;
+}
+
+template<typename T>
+bool ParseList(const char* str, std::vector<T>& out, const char** bad)
+{
+    const char* end = str + strlen(str);
+    out.clear();
+    out.reserve(std::count(str, end, ',') + 1);
+    if (str == end)
+        return true;
+
+    const char* p = str;
+    for (;;)
+    {
+        const char* at = p;
+        T lo;
+        if ((p = ParseNumber(p, end, lo, bad)) == nullptr)
+            return false;
+
+        if (p < end && *p == '-')
+        {
+            T hi;
+            if ((p = ParseNumber(p + 1, end, hi, bad)) == nullptr)
+                return false;
+            if (hi < lo || uint64_t(hi) - uint64_t(lo) >= uint64_t(ListRangeLimit))
+            {
+                *bad = at;
+                return false;
+            }
+            for (T i = lo; ; i++)
+            {
+                out.push_back(i);
+                if (i == hi)
+                    break;
+            }
+        }
+        else
+            out.push_back(lo);
+
+        if (p == end)
+            return true;
+        if (*p != ',')
+        {
+            *bad = p;
+            return false;
+        }
+        p++;
+    }
+}
+}
+
+bool parseList(const char* str, std::vector<int>& out, const char** bad)
+{
+    return ParseList(str, out, bad);
+}
+
+bool parseList(const char* str, std::vector<long long>& out, const char** bad)
+{
+    return ParseList(str, out, bad);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+Converters::Converters()
+{
+    add<const char*>("str");
+    add<int>("int");
+    add<long long>("long");
+    add<double>("double");
+    add<bool>("bool");
+    insert("int,", internal::Converter::withOffsets<std::vector<int>>(parseList));
+    insert("long,", internal::Converter::withOffsets<std::vector<long long>>(parseList));
+}
+
+const Converters& Converters::builtin()
+{
+    static const Converters types;
+    return types;
+}
+
+void Converters::insert(const char* name, const internal::Converter& converter)
+{
+    size_t len = strlen(name);
+    auto pos = std::lower_bound(entries.begin(), entries.end(), len, [name](const Entry& e, size_t l) {
+        return Less(e.name, name, l);
+    });
+    if (pos != entries.end() && pos->name == name)
+        pos->converter = converter;
+    else
+        entries.insert(pos, Entry{ name, converter });
+}
+
+const internal::Converter* Converters::find(const char* b, const char* e) const
+{
+    size_t len = e - b;
+    auto pos = std::lower_bound(entries.begin(), entries.end(), len, [b](const Entry& entry, size_t l) {
+        return Less(entry.name, b, l);
+    });
+    if (pos == entries.end() || pos->name.size() != len || memcmp(pos->name.data(), b, len) != 0)
+        return nullptr;
+    return &pos->converter;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Give each typed value a place in the arena, aligned for its type. The arena is sized
+// once here, and reused by every eval().
+void internal::linkTypes(Cmdline& cmd)
+{
+    Types& t = *cmd.types;
+    t.slotOf.resize(cmd.values.size(), -1);
+
+    size_t size = 0;
+    for (auto& slot : t.slots)
+    {
+        size = (size + slot.converter.align - 1) / slot.converter.align * slot.converter.align;
+        slot.offset = size;
+        size += slot.converter.size;
+    }
+    t.arena.reset(new std::max_align_t[(size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+}
+
+// Convert each typed value that was given, or has a default, into its slot. Flags are
+// converted from what eval() stored for them, so <:bool> is always set. Errors go to
+// errorMsg and set badArgs.
+bool internal::convertTypes(Cmdline& cmd)
+{
+    Types& t = *cmd.types;
+    t.clear();
+
+    bool ok = true;
+    for (auto& slot : t.slots)
+        if (!convertType(cmd, slot))
+            ok = false;
+
+    if (!ok)
+        cmd.badArgs = true;
+    return ok;
+}
+
+// Convert one value, or its default. Errors go to errorMsg.
+bool internal::convertType(Cmdline& cmd, Types::Slot& slot)
+{
+    Types& t = *cmd.types;
+    const Value& value = cmd.values[slot.value];
+    const char* str = nullptr;
+    Defaults::Entry* entry = cmd.defaults ? cmd.defaults->find(slot.value) : nullptr;
+    if (value.exists() || value.maxArgs() == 0)
+        str = value.string();
+    else if (entry != nullptr)
+        str = cmd.defaults->materialize(*entry, value).string();
+    if (str == nullptr)
+        return true;
+
+    const char* bad;
+    if (slot.converter.convert(str, t.at(slot), &bad))
+    {
+        slot.constructed = true;
+        return true;
+    }
+
+    std::string name(slot.name.b, slot.name.e);
+    if (std::find(cmd.positionals.begin(), cmd.positionals.end(), cmd.key(name.c_str())) != cmd.positionals.end())
+        name = "<" + name + ">";
+    else
+        name = (utf8Length(name.data(), name.data() + name.size()) == 1 ? "-" : "--") + name;
+    // Lists can be huge, so only the part from the problem on is shown
+    std::string type(slot.type.b, slot.type.e);
+    if (type.back() == ',')
+        type.back() = ' ', type += "list";
+    if (bad != nullptr)
+        cmd.errorMsg += "bad " + type + " value for " + name + " at byte " + std::to_string(bad - str) + ": " + std::string(bad, strnlen(bad, 16)) + "\n";
+    else
+        cmd.errorMsg += "bad " + type + " value for " + name + ": " + str + "\n";
+    return false;
+}
+
+} // namespace cmdline
@@ -0,0 +1,600 @@
+//=================================================================================================
+// usage.cpp
+//  - compile usage lines into a pattern program, and match argv against it
+//=================================================================================================
+
+#include "cmdline/cmdline.h"
+#include "cmdline/spec.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace cmdline
+{
+
+// Usage lines are docopt-style patterns:
+//
+//  usage: cp [options] <source_file> <target_file>
+//         cp [options] <source_file>... <target_directory>
+//
+// The first word is the program name, and each line that starts with it is another
+// form of the command; any other line continues the one before. Words right after it
+// may be part of the program's name too, as in "git clone" for git-clone: when matching,
+// those that are a part of argv[0]'s file name (split at '-', '_' and '.') are passed
+// over, and the others are command words. In a pattern
+//
+//  [x]      x is optional
+//  (x | y)  one of x or y
+//  x...     one or more x
+//  <name>?, <name>*, <name>+, <name>{m,n}   nargs ranges, as in the option list (a
+//           bounded {m,n} can't go above 64)
+//  <name>   a positional argument
+//  word     a command word that must appear literally
+//  -o, --option[=<arg>]   an option
+//  [options] or [<options>]  any option from the spec
+//
+// Every name in a pattern has to be declared in the spec; a usage line summarizes the
+// options and positionals, it doesn't declare them.
+//
+// Positional arguments and command words are order-sensitive, so they are compiled
+// into a program for a Thompson/Pike NFA. Options can appear anywhere on a command
+// line, so they aren't part of the program; instead each line has a set of allowed
+// options and a set of required ones (those outside any [] or |).
+//
+// Matching runs every line's threads in lockstep over the positional arguments, so it
+// takes time proportional to (arguments x program size) and never backtracks. When
+// more than one line matches, the first one wins, as do the earlier choices within a
+// line; repetition is greedy.
+
+namespace
+{
+typedef std::vector<internal::Usage::Inst> Code;
+
+void Append(Code& code, const Code& more)
+{
+    code.insert(code.end(), more.begin(), more.end());
+}
+
+// [x] becomes: split +1, +(len+1); x
+Code Optional(const Code& x)
+{
+    Code code{ { internal::Usage::Split, 1, (int) x.size() + 1 } };
+    Append(code, x);
+    return code;
+}
+
+// x... becomes: x; split -len, +1
+Code OneOrMore(const Code& x)
+{
+    Code code(x);
+    code.push_back({ internal::Usage::Split, -(int) x.size(), 1 });
+    return code;
+}
+
+// x | y | z becomes: split +1, +(len x + 2); x; jmp +(rest + 1); split ...; z
+Code Alternation(const std::vector<Code>& branches)
+{
+    Code code(branches.back());
+    for (int i = (int) branches.size() - 2; i >= 0; i--)
+    {
+        Code alt{ { internal::Usage::Split, 1, (int) branches[i].size() + 2 } };
+        Append(alt, branches[i]);
+        alt.push_back({ internal::Usage::Jmp, (int) code.size() + 1, 0 });
+        Append(alt, code);
+        code.swap(alt);
+    }
+    return code;
+}
+
+// x{m,n} becomes m copies of x, then n - m nested optional ones: x x [x [x]] for
+// x{2,4}. Without an upper bound, the tail is [x...] instead.
+Code Repeat(const Code& x, int lo, int hi)
+{
+    Code code;
+    for (int k = 0; k < lo; k++)
+        Append(code, x);
+    if (hi == cmdline::Value::Many)
+    {
+        Append(code, Optional(OneOrMore(x)));
+        return code;
+    }
+    Code tail;
+    for (int k = lo; k < hi; k++)
+    {
+        Code more(x);
+        Append(more, tail);
+        tail = Optional(more);
+    }
+    Append(code, tail);
+    return code;
+}
+
+// Bounded repeats in usage lines are written out in the program, so they're kept small
+const int MaxRepeat = 64;
+
+int Intern(std::vector<std::string>& names, const std::string& name)
+{
+    auto pos = std::find(names.begin(), names.end(), name);
+    if (pos != names.end())
+        return (int) (pos - names.begin());
+    names.push_back(name);
+    return (int) names.size() - 1;
+}
+
+bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Compiles one usage pattern (with the program name already removed)
+class PatternCompiler
+{
+public:
+    PatternCompiler(internal::Usage& usage_, internal::Usage::Line& line_, const std::string& text_)
+        : usage(usage_), line(line_), text(text_), pos(0), suffix(0), lo(0), hi(0), leading(true)
+    {}
+
+    bool compile(Code& code)
+    {
+        std::vector<std::string> required;
+        if (!expr(code, &required))
+            return false;
+        line.required.insert(line.required.end(), required.begin(), required.end());
+        return lex(pos) == End;
+    }
+
+private:
+    enum Token { End, Bad, LParen, RParen, LBracket, RBracket, Bar, Ellipsis, Slot, Option, Word };
+
+    // Lex the token at p, leaving p after it, and the token's name and option argument
+    // in str and arg
+    Token lex(size_t& p)
+    {
+        str.clear();
+        arg.clear();
+        suffix = 0;
+        while (p < text.size() && IsSpace(text[p]))
+            p++;
+        if (p == text.size())
+            return End;
+
+        switch (text[p])
+        {
+        case '(': p++; return LParen;
+        case ')': p++; return RParen;
+        case '[': p++; return LBracket;
+        case ']': p++; return RBracket;
+        case '|': p++; return Bar;
+        }
+
+        if (text.compare(p, 3, "...") == 0)
+        {
+            p += 3;
+            return Ellipsis;
+        }
+
+        if (text[p] == '<')
+        {
+            size_t e = text.find('>', p);
+            if (e == std::string::npos)
+                return Bad; // unterminated
+            str = text.substr(p + 1, e - p - 1);
+            p = e + 1;
+            if (p < text.size() && strchr("?*+{", text[p]) != nullptr)
+            {
+                suffix = text[p];
+                if (suffix == '{')
+                {
+                    // A bounded repeat is compiled as written out, so its bounds are
+                    // limited; anything malformed or too big is an error
+                    size_t q = p + 1;
+                    if (!Number(q, lo))
+                        return Bad;
+                    hi = lo;
+                    if (q < text.size() && text[q] == ',')
+                    {
+                        q += 1;
+                        if (!Number(q, hi))
+                            hi = Value::Many;
+                    }
+                    if (q == text.size() || text[q] != '}' || hi < lo || (hi != Value::Many && hi > MaxRepeat))
+                        return Bad;
+                    p = q;
+                }
+                p++;
+            }
+            return Slot;
+        }
+
+        size_t b = p;
+        while (p < text.size() && !IsSpace(text[p]) && !strchr("()[]|=", text[p]) && text.compare(p, 3, "...") != 0)
+            p++;
+        if (p == b)
+            p++; // a stray '=' is a word of its own
+        str = text.substr(b, p - b);
+
+        if (str.size() < 2 || str[0] != '-' || str == "--")
+            return Word;
+
+        // An option, maybe with an argument as --opt=<arg>, --opt=arg or --opt[=<arg>]
+        size_t a = p;
+        bool bracketed = text.compare(a, 2, "[=") == 0;
+        if (bracketed)
+            a += 1;
+        if (a < text.size() && text[a] == '=')
+        {
+            a += 1;
+            size_t e = a;
+            while (e < text.size() && !IsSpace(text[e]) && !strchr("()[]|", text[e]))
+                e++;
+            if (e < text.size() && text[e] == '>')
+                e++;
+            arg = text.substr(a, e - a);
+            if (bracketed && (e == text.size() || text[e] != ']'))
+                return Bad;
+            p = bracketed ? e + 1 : e;
+        }
+
+        str.erase(0, str[1] == '-' ? 2 : 1);
+        return Option;
+    }
+
+    // Read a count at p, leaving p after it
+    bool Number(size_t& p, int& n)
+    {
+        size_t b = p;
+        for (n = 0; p < text.size() && text[p] >= '0' && text[p] <= '9' && p - b < 6; p++)
+            n = n * 10 + (text[p] - '0');
+        return p > b;
+    }
+
+    Token peek()
+    {
+        size_t p = pos;
+        return lex(p);
+    }
+
+    bool accept(Token t)
+    {
+        size_t p = pos;
+        if (lex(p) != t)
+            return false;
+        pos = p;
+        return true;
+    }
+
+    // expr ::= seq ('|' seq)*
+    // Options in a seq are required only if there's no alternative to it
+    bool expr(Code& code, std::vector<std::string>* required)
+    {
+        std::vector<Code> branches;
+        std::vector<std::string> branchRequired;
+        do
+        {
+            branches.emplace_back();
+            branchRequired.clear();
+            if (!seq(branches.back(), required != nullptr ? &branchRequired : nullptr))
+                return false;
+        }
+        while (accept(Bar));
+
+        if (branches.size() == 1 && required != nullptr)
+            required->insert(required->end(), branchRequired.begin(), branchRequired.end());
+        code = Alternation(branches);
+        return true;
+    }
+
+    // seq ::= (atom '...'?)*
+    bool seq(Code& code, std::vector<std::string>* required)
+    {
+        for (;;)
+        {
+            Token t = peek();
+            if (t == End || t == RParen || t == RBracket || t == Bar)
+                return true;
+
+            Code part;
+            if (!atom(part, required))
+                return false;
+            if (accept(Ellipsis))
+                part = OneOrMore(part);
+            Append(code, part);
+        }
+    }
+
+    // atom ::= '(' expr ')' | '[' expr ']' | slot | option | word
+    bool atom(Code& code, std::vector<std::string>* required)
+    {
+        // Only the words at the very start of a line can be part of the program name
+        Token t = lex(pos);
+        bool program = leading && t == Word && str != "options" && str != "--";
+        leading = program;
+        switch (t)
+        {
+        case LParen:
+            return expr(code, required) && accept(RParen);
+
+        case LBracket:
+            if (!expr(code, nullptr) || !accept(RBracket))
+                return false;
+            code = Optional(code);
+            return true;
+
+        case Slot:
+            if (str == "options")
+                line.anyOption = true;
+            else
+                code.push_back({ internal::Usage::Arg, Intern(usage.slots, str), 0 });
+            if (suffix == '{')
+                code = Repeat(code, lo, hi);
+            if (suffix == '+' || suffix == '*')
+                code = OneOrMore(code);
+            if (suffix == '?' || suffix == '*')
+                code = Optional(code);
+            return true;
+
+        case Option:
+            line.allowed.push_back(str);
+            if (required != nullptr)
+                required->push_back(str);
+            if (!arg.empty())
+                usage.optionArgs.push_back(std::make_pair(str, 1));
+            return true;
+
+        case Word:
+            if (str == "options")
+                line.anyOption = true;
+            else if (str != "--") // -- just documents that options end
+                code.push_back({ program ? internal::Usage::Program : internal::Usage::Word, Intern(usage.words, str), 0 });
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    internal::Usage& usage;
+    internal::Usage::Line& line;
+    const std::string& text;
+    size_t pos;
+    std::string str;
+    std::string arg;
+    char suffix;
+    int lo, hi; // the bounds of a {m,n} suffix
+    bool leading; // no token but words yet
+};
+}
+
+// Split the section into patterns, one per line that starts with the program name,
+// and compile them all into one program with an alternation at the top
+bool internal::compileUsage(Fragment section, Usage& usage)
+{
+    const char* p = section.b + 6; // skip "usage:"
+    std::string program;
+    std::vector<std::string> patterns;
+
+    while (p < section.e)
+    {
+        const char* eol = p;
+        while (eol < section.e && *eol != '\n')
+            eol++;
+
+        const char* b = p;
+        while (b < eol && IsSpace(*b))
+            b++;
+        const char* w = b;
+        while (w < eol && !IsSpace(*w))
+            w++;
+        std::string first(b, w);
+        p = eol < section.e ? eol + 1 : eol;
+
+        if (first.empty())
+            continue;
+        if (program.empty())
+            program = first;
+        if (first == program)
+            patterns.push_back(std::string(w, eol));
+        else if (!patterns.empty())
+            patterns.back().append(" ").append(b, eol);
+    }
+
+    std::vector<Code> lines;
+    for (auto& pattern : patterns)
+    {
+        usage.lines.emplace_back();
+        usage.lines.back().anyOption = false;
+
+        Code code;
+        PatternCompiler compiler(usage, usage.lines.back(), pattern);
+        if (!compiler.compile(code))
+            return false;
+        code.push_back({ Usage::Match, (int) usage.lines.size() - 1, 0 });
+        lines.push_back(code);
+    }
+
+    if (!lines.empty())
+        usage.code = Alternation(lines);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace
+{
+// Find a name from a usage line in the spec, or report it
+int Find(Cmdline& cmd, const std::string& name, const char* what, bool& ok)
+{
+    auto pos = cmd.options.find(cmd.key(name.c_str()));
+    if (pos != cmd.options.end())
+        return pos->second;
+    std::string error = std::string("usage line names an undeclared ") + what + ": " + name + "\n";
+    if (cmd.errorMsg.find(error) == std::string::npos)
+        cmd.errorMsg += error;
+    ok = false;
+    return -1;
+}
+}
+
+// Once the whole spec is studied, resolve the names in the usage patterns to values.
+// A name that isn't declared is an error in the spec, and the patterns are dropped, so
+// eval() assigns positionals in declaration order as if there were no usage lines.
+bool internal::linkUsage(Cmdline& cmd)
+{
+    Usage& usage = *cmd.usagePatterns;
+    bool ok = true;
+
+    for (auto& slot : usage.slots)
+        usage.slotValues.push_back(Find(cmd, slot, "positional", ok));
+
+    for (auto& opt : usage.optionArgs)
+    {
+        int v = Find(cmd, opt.first, "option", ok);
+        if (v >= 0 && cmd.values[v].nargs() == 0)
+            cmd.values[v].nargs(opt.second);
+    }
+
+    for (auto& line : usage.lines)
+    {
+        for (auto& name : line.allowed)
+            line.allowedValues.push_back(Find(cmd, name, "option", ok));
+        for (auto& name : line.required)
+            line.requiredValues.push_back(Find(cmd, name, "option", ok));
+        std::sort(line.allowedValues.begin(), line.allowedValues.end());
+    }
+
+    if (!ok)
+        usage = Usage();
+    return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace
+{
+// Is word one of the parts of the program's file name? For /usr/libexec/git-clone the
+// parts are git and clone.
+bool NamesProgram(const char* program, const std::string& word)
+{
+    if (program == nullptr)
+        return false;
+    const char* base = program;
+    for (const char* p = program; *p != '\0'; p++)
+        if (*p == '/' || *p == '\\')
+            base = p + 1;
+
+    for (const char* b = base; *b != '\0'; )
+    {
+        const char* e = b;
+        while (*e != '\0' && *e != '-' && *e != '_' && *e != '.')
+            e++;
+        if ((size_t) (e - b) == word.size() && word.compare(0, word.size(), b, e - b) == 0)
+            return true;
+        b = *e != '\0' ? e + 1 : e;
+    }
+    return false;
+}
+
+// Pike VM over the positional arguments. Each step keeps at most one thread per
+// instruction, in priority order. For every thread we also record which consuming
+// instruction it came from, so the winning path can be traced back afterwards
+// without threads carrying their own capture lists.
+class UsageMatcher
+{
+public:
+    UsageMatcher(const internal::Usage& usage_, const char* program, int steps)
+        : usage(usage_), size((int) usage_.code.size()), mark(size, -1)
+        , from((steps + 1) * size, -1), named(usage_.words.size(), 0)
+    {
+        for (size_t w = 0; w < usage.words.size(); w++)
+            named[w] = NamesProgram(program, usage.words[w]);
+    }
+
+    // Match the arguments, and on success fill in the slot each argument went to
+    // (-1 for command words). Returns the matched line, or -1.
+    int match(const std::vector<const char*>& args, std::vector<int>& slots)
+    {
+        std::vector<int> clist, nlist;
+        clist.reserve(size);
+        nlist.reserve(size);
+
+        add(clist, 0, 0, -1);
+        for (int step = 0; step < (int) args.size(); step++)
+        {
+            nlist.clear();
+            for (int pc : clist)
+            {
+                auto& inst = usage.code[pc];
+                bool word = inst.op == internal::Usage::Word || inst.op == internal::Usage::Program;
+                if (inst.op == internal::Usage::Arg || (word && usage.words[inst.x] == args[step]))
+                    add(nlist, pc + 1, step + 1, pc);
+            }
+            clist.swap(nlist);
+        }
+
+        int n = (int) args.size();
+        for (int pc : clist)
+        {
+            if (usage.code[pc].op != internal::Usage::Match)
+                continue;
+
+            slots.assign(n, -1);
+            int c = from[n * size + pc];
+            for (int step = n - 1; step >= 0; step--)
+            {
+                if (usage.code[c].op == internal::Usage::Arg)
+                    slots[step] = usage.code[c].x;
+                c = from[step * size + c];
+            }
+            return usage.code[pc].x;
+        }
+        return -1;
+    }
+
+private:
+    // Add a thread and follow its jumps and splits, first branch first
+    void add(std::vector<int>& list, int pc, int step, int origin)
+    {
+        if (mark[pc] == step)
+            return;
+        mark[pc] = step;
+        from[step * size + pc] = origin;
+
+        auto& inst = usage.code[pc];
+        switch (inst.op)
+        {
+        case internal::Usage::Jmp:
+            add(list, pc + inst.x, step, origin);
+            break;
+        case internal::Usage::Split:
+            add(list, pc + inst.x, step, origin);
+            add(list, pc + inst.y, step, origin);
+            break;
+        case internal::Usage::Program:
+            if (named[inst.x])
+                add(list, pc + 1, step, origin);
+            else
+                list.push_back(pc);
+            break;
+        default:
+            list.push_back(pc);
+            break;
+        }
+    }
+
+    const internal::Usage& usage;
+    int size;
+    std::vector<int> mark;
+    std::vector<int> from;
+    std::vector<char> named; // each word is part of the program's name
+};
+}
+
+int internal::matchUsage(const Usage& usage, const char* program, const std::vector<const char*>& args, std::vector<int>& slots)
+{
+    if (usage.code.empty())
+        return -1;
+    UsageMatcher matcher(usage, program, (int) args.size());
+    return matcher.match(args, slots);
+}
+
+} // namespace cmdline
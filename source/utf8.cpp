@@ -0,0 +1,123 @@
+//=================================================================================================
+// utf8.cpp
+//  - UTF-8 validation and case folding
+//=================================================================================================
+
+#include "cmdline/utf8.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CMDLINE_SSE2 1
+#endif
+
+namespace cmdline
+{
+
+// Skip ASCII a block at a time; a block that has a high bit set somewhere is finished
+// a byte at a time, which is at most a block's worth before the next non-ASCII byte.
+// The rest is the usual table-free check of each multibyte sequence (see RFC 3629 for
+// the ranges of the second byte).
+bool validUtf8(const char* b, const char* e, const char** bad)
+{
+    auto p = reinterpret_cast<const unsigned char*>(b);
+    auto end = reinterpret_cast<const unsigned char*>(e);
+
+    while (p < end)
+    {
+        if (*p < 0x80)
+        {
+#if defined(CMDLINE_SSE2)
+            while (end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) == 0)
+                p += 16;
+#endif
+            for (uint64_t w; end - p >= 8; p += 8)
+            {
+                memcpy(&w, p, 8);
+                if ((w & 0x8080808080808080ull) != 0)
+                    break;
+            }
+            while (p < end && *p < 0x80)
+                p++;
+            continue;
+        }
+
+        int n;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (*p >= 0xC2 && *p <= 0xDF)
+            n = 1;
+        else if (*p >= 0xE0 && *p <= 0xEF)
+        {
+            n = 2;
+            if (*p == 0xE0) lo = 0xA0; // overlong
+            if (*p == 0xED) hi = 0x9F; // surrogates
+        }
+        else if (*p >= 0xF0 && *p <= 0xF4)
+        {
+            n = 3;
+            if (*p == 0xF0) lo = 0x90; // overlong
+            if (*p == 0xF4) hi = 0x8F; // past U+10FFFF
+        }
+        else
+            break;
+
+        if (end - p <= n || p[1] < lo || p[1] > hi)
+            break;
+        int k = 2;
+        while (k <= n && (p[k] & 0xC0) == 0x80)
+            k++;
+        if (k <= n)
+            break;
+        p += n + 1;
+    }
+
+    if (p == end)
+        return true;
+    if (bad != nullptr)
+        *bad = reinterpret_cast<const char*>(p);
+    return false;
+}
+
+size_t utf8Length(const char* b, const char* e)
+{
+    size_t n = 0;
+    for (; b < e; b++)
+        n += (*b & 0xC0) != 0x80;
+    return n;
+}
+
+// Only two-byte capitals outside ASCII are folded, and each of those folds to another
+// two-byte code point, so the string never changes length
+void foldCase(char* b, char* e)
+{
+    for (auto p = reinterpret_cast<unsigned char*>(b); p < reinterpret_cast<unsigned char*>(e); p++)
+    {
+        if (*p >= 'A' && *p <= 'Z')
+        {
+            *p += 'a' - 'A';
+            continue;
+        }
+        if (*p < 0xC2 || *p > 0xDF || p + 1 == reinterpret_cast<unsigned char*>(e) || (p[1] & 0xC0) != 0x80)
+            continue;
+
+        unsigned c = ((p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+        if ((c >= 0xC0 && c <= 0xDE && c != 0xD7)      // Latin-1
+            || (c >= 0x391 && c <= 0x3AB && c != 0x3A2) // Greek
+            || (c >= 0x410 && c <= 0x42F))              // Cyrillic
+            c += 0x20;
+        else if (c >= 0x400 && c <= 0x40F)              // Cyrillic with marks
+            c += 0x50;
+        else
+        {
+            p++;
+            continue;
+        }
+        p[0] = (unsigned char) (0xC0 | (c >> 6));
+        p[1] = (unsigned char) (0x80 | (c & 0x3F));
+        p++;
+    }
+}
+
+} // namespace cmdline
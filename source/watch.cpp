@@ -0,0 +1,138 @@
+//=================================================================================================
+// watch.cpp
+//  - hot reloading of spec files for long-running programs
+//=================================================================================================
+
+#include "cmdline/watch.h"
+#include "cmdline/specfile.h"
+
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cmdline
+{
+
+SpecWatcher::SpecWatcher(const char* path_, int flags_) : path(path_), flags(flags_), numSwaps(0), notifyFd(-1)
+{
+    wakeFds[0] = wakeFds[1] = -1;
+    reload();
+
+#if defined(__linux__)
+    // Watch the directory rather than the file, since a file renamed over this one is
+    // a different inode
+    std::string dir = ".";
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos)
+        dir = slash == 0 ? "/" : path.substr(0, slash);
+
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd < 0)
+        return;
+    if (inotify_add_watch(notifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe2(wakeFds, O_CLOEXEC) != 0)
+    {
+        close(notifyFd);
+        notifyFd = -1;
+        return;
+    }
+    thread = std::thread([this]() { watch(); });
+#endif
+}
+
+SpecWatcher::~SpecWatcher()
+{
+#if defined(__linux__)
+    if (thread.joinable())
+    {
+        char stop = 0;
+        while (write(wakeFds[1], &stop, 1) < 0 && errno == EINTR)
+            ;
+        thread.join();
+    }
+    if (notifyFd >= 0)
+        close(notifyFd);
+    for (int fd : wakeFds)
+        if (fd >= 0)
+            close(fd);
+#endif
+}
+
+// The new group is studied without holding up readers, who keep using the old one
+// until it's swapped in. The file is read rather than mapped: groups hold views into
+// the text, and the file may be rewritten in place while they (or this study) are
+// still using it.
+bool SpecWatcher::reload()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto file = SpecFile::read(path.c_str());
+    if (!file)
+    {
+        lastError = "can't read " + path + ": " + strerror(errno) + "\n";
+        return false;
+    }
+    auto studied = OptionGroup::study(std::move(file), flags);
+    if (studied->failed())
+    {
+        lastError = path + " didn't study:\n" + studied->errors();
+        return false;
+    }
+
+    std::atomic_store(&group, studied);
+    numSwaps++;
+    lastError.clear();
+    return true;
+}
+
+std::string SpecWatcher::error() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastError;
+}
+
+// Wait for events in the directory, and reload after any batch that names our file.
+// An editor's save can be a burst of events, but one reload covers them all.
+void SpecWatcher::watch()
+{
+#if defined(__linux__)
+    std::string name = path.substr(path.rfind('/') + 1);
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+        struct pollfd fds[2] = { { notifyFd, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents != 0)
+            return;
+
+        bool changed = false;
+        for (;;)
+        {
+            ssize_t got = read(notifyFd, buffer, sizeof(buffer));
+            if (got <= 0)
+                break;
+            for (char* p = buffer; p < buffer + got; )
+            {
+                auto event = reinterpret_cast<const struct inotify_event*>(p);
+                if (event->len > 0 && name == event->name)
+                    changed = true;
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (changed)
+            reload();
+    }
+#endif
+}
+
+} // namespace cmdline
@@ -0,0 +1,82 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/bind.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+void PrintValue(const cmdline::Cmdline& cmd, const char* option)
+{
+    const cmdline::Value& value = cmd[option];
+    printf("%s: exists=%s", option, value.exists() ? "true" : "false");
+    for (int i = 0; i < value.count(); i++)
+        printf(" %s", value.arg(i));
+    printf(value.count() == 0 ? " (%s)\n" : "\n", value.string());
+}
+}
+
+AUTO_REGISTER(Actions)
+{
+    printf("-------------------------------------------\n");
+    printf("Actions\n");
+
+    char spec[] = R"raw(
+        <files>*
+        -v, --verbose          more output; give it again for more (action: count)
+        -q, --quiet            (action: store_false)
+        -O, --optimize         build for speed (action: store_const fast)
+        -t, --tag <tag>        tag the build; can be repeated (action: append)
+        --release              (action: append_const release)
+        --debug                (action: append_const debug)
+        -x                     extract
+        -f, --file <archive>   the archive
+        -ω                     a flag with a longer name
+    )raw";
+
+    int argc = 13;
+    char* argv[] = { "tool", "-vvv", "-t", "a", "a.c", "--release", "-xωf", "out.tar", "--tag=b", "-O", "--debug", "-v", "b.c" };
+    PrintArgs(argc, argv);
+    cmdline::Cmdline cmd(argc, argv, spec);
+    printf("failed=%s badArgs=%s %s", cmd.failed ? "true" : "false", cmd.badArgs ? "true" : "false", cmd.errorMsg.c_str());
+    for (auto option : { "verbose", "quiet", "optimize", "tag", "release", "debug", "x", "ω", "file", "files" })
+        PrintValue(cmd, option);
+    int verbose = 0;
+    cmd.get("verbose", verbose);
+    printf("verbose as int=%d\n", verbose);
+
+    // Evaluating again starts the counts and lists over
+    char* again[] = { "tool", "-q", "-v" };
+    cmdline::Cmdline second(spec);
+    second.eval(3, again);
+    second.eval(3, again);
+    PrintValue(second, "verbose");
+    PrintValue(second, "quiet");
+
+    // A counted flag that a usage line requires is there when the line is checked
+    char counted[] = "usage: tool -v <file>\n\n    <file>    what to read\n    -v        more output (action: count)\n";
+    char* once[] = { "tool", "-v", "x" };
+    cmdline::Cmdline required(counted);
+    required.eval(3, once);
+    printf("required count: badArgs=%s %s", required.badArgs ? "true" : "false", required.errorMsg.c_str());
+    PrintValue(required, "v");
+
+    // So is a flag with an action in a cluster, where the line doesn't allow it
+    char allowing[] = "usage: tool -v <file>\n\n    <file>    what to read\n    -v        more output (action: count)\n    -q        less output (action: store_false)\n";
+    char* clustered[] = { "tool", "-qv", "x" };
+    cmdline::Cmdline quiet(allowing);
+    quiet.eval(3, clustered);
+    printf("clustered: badArgs=%s %s", quiet.badArgs ? "true" : "false", quiet.errorMsg.c_str());
+    PrintValue(quiet, "q");
+
+    // Actions that don't fit the option fail the spec
+    char bad[] = "    -n <n>    (action: count)\n    --set    (action: store_const)\n    --go    (action: launch)\n";
+    cmdline::Cmdline broken(bad);
+    printf("bad spec: failed=%s %s", broken.failed ? "true" : "false", broken.errorMsg.c_str());
+    char last[] = "    --go    (action: launch)\n";
+    cmdline::Cmdline unknown(last);
+    printf("unknown action last: failed=%s %s", unknown.failed ? "true" : "false", unknown.errorMsg.c_str());
+    printf("\n");
+}
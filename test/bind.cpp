@@ -0,0 +1,109 @@
+#include "cmdline/bind.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace {
+
+struct CloneConfig
+{
+    bool verbose;
+    int jobs;
+    const char* origin;
+    const char* repository;
+};
+
+const cmdline::Binding<CloneConfig> cloneBinding {
+    { "verbose", &CloneConfig::verbose },
+    { "jobs", &CloneConfig::jobs },
+    { "origin", &CloneConfig::origin },
+    { "repository", &CloneConfig::repository },
+};
+
+}
+
+AUTO_REGISTER(BindStruct)
+{
+    printf("-------------------------------------------\n");
+    printf("BindStruct\n");
+	int argc = 5;
+	char* argv[] = { "git-clone", "--verbose", "-j", "8", "git@github.com:neurocline/cmdline.git" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(R"raw(
+usage: git clone [<options>] [--] <repository>
+
+    <repository>          location of upstream repo
+
+    -v, --verbose         be more verbose
+    -j, --jobs <n>        number of submodules cloned in parallel
+    -o, --origin <name>   use <name> instead of 'origin' to track upstream
+)raw");
+
+    CloneConfig config{ false, 1, "origin", nullptr };
+    if (!cmd.bind(config, cloneBinding))
+        printf("Binding failed\n");
+    cmd.eval(argc, argv);
+
+    if (cmd.badArgs)
+        printf("Errors:\n%s", cmd.errorMsg.c_str());
+    printf("verbose=%s\n", config.verbose ? "true" : "false");
+    printf("jobs=%d\n", config.jobs);
+    printf("origin=%s\n", config.origin);
+    printf("repository=%s\n", config.repository ? config.repository : "<null>");
+
+    printf("\n");
+}
+
+// A bound field that isn't given gets the spec's default
+AUTO_REGISTER(BindDefaults)
+{
+    printf("-------------------------------------------\n");
+    printf("BindDefaults\n");
+	int argc = 2;
+	char* argv[] = { "git-clone", "url" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(R"raw(
+    <repository>          location of upstream repo
+    -v, --verbose         be more verbose
+    -j, --jobs <n>        number of submodules cloned in parallel (default: 4)
+    -o, --origin <name>   use <name> instead of 'origin' to track upstream
+)raw");
+    CloneConfig config{ false, 1, "origin", nullptr };
+    cmd.bind(config, cloneBinding);
+    cmd.eval(argc, argv);
+
+    printf("jobs=%d origin=%s repository=%s\n", config.jobs, config.origin, config.repository);
+    printf("\n");
+}
+
+AUTO_REGISTER(BindUnknownField)
+{
+    printf("-------------------------------------------\n");
+    printf("BindUnknownField\n");
+	int argc = 3;
+	char* argv[] = { "git-clone", "-j", "4" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(R"raw(
+    -j, --jobs <n>        number of submodules cloned in parallel
+)raw");
+
+    // A misspelled field is the caller's mistake; the spec is still good
+    static const cmdline::Binding<CloneConfig> typo {
+        { "jobs", &CloneConfig::jobs },
+        { "verbsoe", &CloneConfig::verbose },
+    };
+    CloneConfig config{ false, 1, "origin", nullptr };
+    bool ok = cmd.bind(config, typo);
+    cmd.eval(argc, argv);
+
+    printf("bind=%s failed=%s badArgs=%s\n", ok ? "true" : "false", cmd.failed ? "true" : "false",
+        cmd.badArgs ? "true" : "false");
+    printf("Errors:\n%s", cmd.errorMsg.c_str());
+    printf("jobs=%d\n", config.jobs);
+
+    printf("\n");
+}
@@ -0,0 +1,95 @@
+#include "cmdline/cmdline.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+char ConstraintSpec[] = R"raw(
+usage: git-clone [<options>] [--] <repo> [<dir>]
+
+    <repo>                location of upstream repo
+    <dir>                 local directory to clone into
+
+    -v, --verbose         be more verbose (conflicts: -q)
+    -q, --quiet           be more quiet
+    --bare                create a bare repository
+    --mirror              create a mirror repository (implies: --bare)
+    --reference <repo>    reference repository
+    --dissociate          use --reference only while cloning (requires: --reference)
+    -4, --ipv4            use IPv4 addresses only (exclusive: address)
+    -6, --ipv6            use IPv6 addresses only (exclusive: address)
+)raw";
+
+void Run(int argc, char* argv[])
+{
+    PrintArgs(argc, argv);
+
+    cmdline::Cmdline cmd(ConstraintSpec);
+    cmd.eval(argc, argv);
+    printf("failed=%s badArgs=%s\n", cmd.failed ? "true" : "false", cmd.badArgs ? "true" : "false");
+    if (cmd.badArgs)
+        printf("errors:\n%s", cmd.errorMsg.c_str());
+    printf("bare=%s\n\n", cmd["bare"].string());
+}
+}
+
+AUTO_REGISTER(OptionConstraints)
+{
+    printf("-------------------------------------------\n");
+    printf("OptionConstraints\n");
+
+    {
+        char* argv[] = { "git-clone", "--mirror", "-4", "url" };
+        Run(4, argv);
+    }
+    {
+        char* argv[] = { "git-clone", "--quiet", "-v", "--dissociate", "-4", "-6", "url" };
+        Run(7, argv);
+    }
+    {
+        char* argv[] = { "git-clone", "--dissociate", "--reference", "../other", "url" };
+        Run(5, argv);
+    }
+
+    // Constraints must name options in the spec
+    {
+        char spec[] = R"raw(
+    --fast      go fast (conflicts: --slow)
+)raw";
+        cmdline::Cmdline cmd(spec);
+        printf("unknown name: failed=%s %s", cmd.failed ? "true" : "false", cmd.errorMsg.c_str());
+    }
+
+    // An implied flag reads the way its action would have set it
+    {
+        char spec[] = R"raw(
+    --mirror      (implies: --no-color, --level, --verbose)
+    --no-color    (action: store_false)
+    --level       (action: store_const fast)
+    --verbose     (action: count)
+)raw";
+        cmdline::Cmdline cmd(spec);
+        char* argv[] = { "tool", "--mirror" };
+        cmd.eval(2, argv);
+        printf("implied actions: no-color=%s level=%s verbose=%s\n", cmd["no-color"].string(), cmd["level"].string(),
+            cmd["verbose"].string());
+    }
+
+    // A big spec with one constraint only has mask rows for the two options in it
+    {
+        std::string spec;
+        for (int i = 0; i < 10000; i++)
+            spec += "    --opt" + std::to_string(i) + "    option " + std::to_string(i) + "\n";
+        spec += "    --fast    go fast (conflicts: --opt9999)\n";
+        cmdline::Cmdline cmd(&spec[0]);
+        char* argv[] = { "big", "--fast", "--opt9999" };
+        cmd.eval(3, argv);
+        auto& c = *cmd.constraints;
+        printf("big spec: mask words=%d errors: %s", (int) (c.conflicts.size() + c.required.size() + c.implies.size()),
+            cmd.errorMsg.c_str());
+    }
+    printf("\n");
+}
@@ -0,0 +1,56 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/bind.h"
+#include "cmdline/result.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+extern void PrintArgs(int argc, char* argv[]);
+
+AUTO_REGISTER(SpecDefaults)
+{
+    printf("-------------------------------------------\n");
+    printf("SpecDefaults\n");
+	int argc = 4;
+	char* argv[] = { "serve", "--port", "9000", "site" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(R"raw(
+usage: serve [<options>] <root> [<log>]
+
+    <root>                directory to serve
+    <log>                 where to write the log (default: serve.log)
+
+    -p, --port <port>     port to listen on (default: 8080)
+    -t, --timeout <secs>  idle timeout (default: 2.5)
+    -w, --workers <n>     worker threads (default to one per core)
+    -v, --verbose         be more verbose
+)raw");
+    cmd.eval(argc, argv);
+
+    // Given values win over defaults
+    int port = 0;
+    bool ok = cmd.get("port", port);
+    printf("port=%s get=%s %d\n", cmd["port"].string(), ok ? "true" : "false", port);
+
+    // Defaults come back through operator[], but don't count as given
+    auto& log = cmd["log"];
+    printf("log=%s exists=%s\n", log.string(), log.exists() ? "true" : "false");
+
+    // A typed default is converted once, then cached
+    double timeout = 0;
+    cmd.get("timeout", timeout);
+    printf("timeout=%g", timeout);
+    timeout = 0;
+    cmd.get("timeout", timeout);
+    printf(" again=%g\n", timeout);
+
+    // Prose like "default to ..." isn't an annotation
+    int workers = -1;
+    ok = cmd.get("workers", workers);
+    printf("workers=%s get=%s\n", cmd["workers"].string(), ok ? "true" : "false");
+
+    auto result = cmd.freeze();
+    printf("frozen log=%s exists=%s\n", (*result)["log"].string(), (*result)["log"].exists() ? "true" : "false");
+
+    printf("\n");
+}
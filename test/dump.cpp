@@ -0,0 +1,52 @@
+#include "cmdline/cmdline.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+
+extern void PrintArgs(int argc, char* argv[]);
+extern std::atomic<int> allocations; // see fixed.cpp
+
+AUTO_REGISTER(DeclarationOrder)
+{
+    printf("-------------------------------------------\n");
+    printf("DeclarationOrder\n");
+
+    char spec[] = R"raw(
+        <src>*                  files to copy
+        -v, --verbose           say what's happening
+        -o, --output <file>     where to put them
+        -x, --exclude <glob>... skip files that match
+        -j, --jobs <n>          copies at once
+        -k <n>                  backups to keep
+    )raw";
+    cmdline::Cmdline cmd(spec);
+
+    int argc = 10;
+    char* argv[] = { "copy", "a.txt", "--output=\"out\"\n", "-v", "b.txt", "-k", "2", "-x", "*.o", "*.a" };
+    PrintArgs(argc, argv);
+    cmd.eval(argc, argv);
+
+    for (auto& p : cmd.results())
+        printf("%s: arg=%d count=%d positional=%s\n", p.name, p.arg, p.value->count(), p.positional ? "true" : "false");
+
+    std::string out;
+    cmd.dump(out);
+    cmd.dump(out, cmdline::Cmdline::DumpJson);
+    printf("%s", out.c_str());
+
+    // A reused buffer doesn't allocate once it has grown
+    out.clear();
+    cmd.dump(out, cmdline::Cmdline::DumpJson);
+    cmd.state(out);
+    int before = allocations;
+    for (int i = 0; i < 100; i++)
+    {
+        out.clear();
+        cmd.dump(out, cmdline::Cmdline::DumpJson);
+        cmd.state(out);
+    }
+    printf("allocations=%d\n", allocations - before);
+    printf("\n");
+}
@@ -0,0 +1,43 @@
+#include "cmdline/cmdline.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+extern void PrintArgs(int argc, char* argv[]);
+
+AUTO_REGISTER(EventHandlers)
+{
+    printf("-------------------------------------------\n");
+    printf("EventHandlers\n");
+	int argc = 6;
+	char* argv[] = { "infer", "--input", "data.bin", "-m=resnet", "-v", "out.bin" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(R"raw(
+usage: infer [<options>] <output>
+
+    <output>              where to write results
+
+    -i, --input <path>    file to read
+    -m, --model <name>    model to warm up
+    -v, --verbose         be more verbose
+)raw");
+
+    // Start work as soon as each option is seen; --model isn't kept afterwards
+    cmd.on("input", [](const cmdline::Event& e) {
+        printf("opening %s (argv[%d])\n", e.str, e.arg);
+    });
+    cmd.on("model", [](const cmdline::Event& e) {
+        printf("warming %s via -%s (argv[%d])\n", e.str, e.name, e.arg);
+    }, false);
+    cmd.onAny([](const cmdline::Event& e) {
+        printf("  saw %s%s=%s\n", e.positional ? "<positional> " : "", e.name, e.str);
+    });
+
+    cmd.eval(argc, argv);
+
+    printf("input=%s\n", cmd["input"].string());
+    printf("model exists=%s\n", cmd["model"].exists() ? "true" : "false");
+    printf("output=%s\n", cmd["output"].string());
+
+    printf("\n");
+}
@@ -0,0 +1,89 @@
+#include "cmdline/fixed.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+extern void PrintArgs(int argc, char* argv[]);
+
+// Count heap allocations, so we can check that FixedCmdline makes none. Some tests
+// allocate on other threads, so the count is atomic.
+std::atomic<int> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations += 1;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    abort();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    allocations += 1;
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace {
+
+const char* lsSpec = R"raw(
+usage: ls [<options>] <dir>
+
+    <dir>                 directory to list
+
+    -a, --all             include hidden entries
+    -l                    list in long format
+    -w, --width <cols>    assume screen width of <cols>
+)raw";
+
+}
+
+AUTO_REGISTER(FixedNoHeap)
+{
+    printf("-------------------------------------------\n");
+    printf("FixedNoHeap\n");
+	int argc = 5;
+	char* argv[] = { "ls", "-a", "--width=120", "-l", "/tmp" };
+    PrintArgs(argc, argv);
+
+    int before = allocations;
+    cmdline::FixedCmdline<8, 8> cmd(argc, argv, lsSpec);
+    int used = allocations - before;
+
+    printf("allocations=%d\n", used);
+    printf("error=%s\n", cmd.errorMessage());
+    printf("all=%s width=%s l=%s dir=%s\n",
+        cmd["all"].string(), cmd["w"].string(), cmd["l"].string(), cmd["dir"].string());
+
+    printf("\n");
+}
+
+AUTO_REGISTER(FixedCapacity)
+{
+    printf("-------------------------------------------\n");
+    printf("FixedCapacity\n");
+	int argc = 3;
+	char* argv[] = { "ls", "-a", "/tmp" };
+    PrintArgs(argc, argv);
+
+    // six option names don't fit in four slots
+    cmdline::FixedCmdline<4, 8> small(argc, argv, lsSpec);
+    printf("names: %s\n", small.errorMessage());
+
+    // two arguments don't fit in one slot
+    cmdline::FixedCmdline<8, 1> narrow(argc, argv, lsSpec);
+    printf("args: %s (argv[%d])\n", narrow.errorMessage(), narrow.errorArg());
+
+    printf("\n");
+}
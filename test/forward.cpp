@@ -0,0 +1,80 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/forward.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+
+extern void PrintArgs(int argc, char* argv[]);
+
+AUTO_REGISTER(ForwardArgv)
+{
+    printf("-------------------------------------------\n");
+    printf("ForwardArgv\n");
+
+    char spec[] = R"raw(
+        <targets>*            what to build
+        -n, --dry-run         only say what would be done
+        -j, --jobs <n>        how many at once
+        -C, --directory <dir> where to build
+        -D, --define <name=value>...   variables
+        --no-print-directory
+    )raw";
+    int argc = 11;
+    char* argv[] = { "wrap", "-n", "all", "-j", "4", "-D", "A=1", "B=2", "--dry-run", "--", "-weird" };
+    PrintArgs(argc, argv);
+    cmdline::Cmdline cmd(argc, argv, spec, cmdline::Cmdline::Lazy);
+
+    cmdline::ArgvBuilder child(cmd);
+    child.program("/usr/bin/make");
+    child.drop("dry-run");
+    child.set("jobs", "16");
+    child.set("directory", "/src/tree");
+    child.replace("define", { "-D", "A=3" });
+    child.add({ "--no-print-directory" });
+    printf("unknown option: %s\n", child.drop("nope") ? "dropped" : "false");
+
+    char** out = child.build();
+    for (int i = 0; i < child.argc(); i++)
+    {
+        bool original = false;
+        for (int k = 0; k < argc; k++)
+            original = original || out[i] == argv[k];
+        printf("  %s%s\n", out[i], original ? " (original)" : "");
+    }
+    printf("terminated=%s\n", out[child.argc()] == nullptr ? "true" : "false");
+
+    // Without edits, argv comes back as it was
+    cmdline::ArgvBuilder same(cmd);
+    char** copy = same.build();
+    bool identical = same.argc() == argc;
+    for (int i = 0; identical && i < argc; i++)
+        identical = copy[i] == argv[i];
+    printf("unedited identical=%s\n", identical ? "true" : "false");
+
+    // Editing an option in a cluster splits it, and the rest keep their arguments
+    char tar[] = R"raw(
+        <files>*
+        -x              extract
+        -v              say more
+        -z              decompress
+        -f <archive>    the archive
+    )raw";
+    char* packed[] = { "wrap", "-xvzf", "a.tgz", "dir" };
+    PrintArgs(4, packed);
+    cmdline::Cmdline untar(4, packed, tar);
+    struct { const char* drop; const char* set; } edits[] = { { "v", nullptr }, { "f", nullptr }, { "z", "x" }, { nullptr, "f" } };
+    for (auto& e : edits)
+    {
+        cmdline::ArgvBuilder split(untar);
+        if (e.drop != nullptr)
+            split.drop(e.drop);
+        if (e.set != nullptr)
+            split.set(e.set, e.drop == nullptr ? "b.tgz" : nullptr);
+        char** args = split.build();
+        printf("drop=%s set=%s:", e.drop != nullptr ? e.drop : "-", e.set != nullptr ? e.set : "-");
+        for (int i = 0; i < split.argc(); i++)
+            printf(" %s", args[i]);
+        printf("\n");
+    }
+    printf("\n");
+}
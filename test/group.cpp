@@ -0,0 +1,66 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/bind.h"
+#include "cmdline/group.h"
+#include "cmdline/result.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+extern void PrintArgs(int argc, char* argv[]);
+
+AUTO_REGISTER(SharedOptionGroups)
+{
+    printf("-------------------------------------------\n");
+    printf("SharedOptionGroups\n");
+
+    // Studied once, shared by every subcommand
+    auto global = cmdline::OptionGroup::study(R"raw(
+    -v, --verbose         be more verbose
+    -c, --config <file>   configuration file (default: tool.ini)
+    -j, --jobs <n>        parallel jobs (default: 4)
+)raw");
+
+    char buildSpec[] = R"raw(
+usage: build [<options>] <target>
+
+    <target>              what to build
+    -r, --release         optimized build
+    -j, --jobs <n>        parallel jobs, overriding the global default (default: 8)
+)raw";
+    char testSpec[] = R"raw(
+usage: test [<options>] <filter>
+
+    <filter>              tests to run
+)raw";
+
+    {
+        int argc = 5;
+        char* argv[] = { "build", "-v", "--release", "app", "--config=ci.ini" };
+        PrintArgs(argc, argv);
+
+        cmdline::Cmdline cmd(buildSpec);
+        cmd.include(global);
+        cmd.eval(argc, argv);
+
+        int jobs = 0;
+        cmd.get("jobs", jobs);
+        printf("badArgs=%s verbose=%s release=%s config=%s jobs=%d target=%s\n", cmd.badArgs ? "true" : "false",
+            cmd["verbose"].string(), cmd["release"].string(), cmd["config"].string(), jobs, cmd["target"].string());
+    }
+    {
+        int argc = 4;
+        char* argv[] = { "test", "--jobs", "2", "unit*" };
+        PrintArgs(argc, argv);
+
+        cmdline::Cmdline cmd(testSpec);
+        cmd.include(global);
+        cmd.on("jobs", [](const cmdline::Event& e) { printf("event %s=%s\n", e.name, e.str); });
+        cmd.eval(argc, argv);
+
+        auto result = cmd.freeze();
+        printf("badArgs=%s verbose=%s config=%s jobs=%s filter=%s\n", cmd.badArgs ? "true" : "false",
+            (*result)["verbose"].string(), (*result)["config"].string(), (*result)["jobs"].string(), (*result)["filter"].string());
+    }
+    printf("group users=%d\n", (int) global.use_count());
+
+    printf("\n");
+}
@@ -0,0 +1,56 @@
+#include "cmdline/cmdline.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+char KeyValueSpec[] = R"raw(
+    -c, --config <key=value>      set a configuration variable
+    -D, --define <name=value:@>   define a macro; a name can be given more than once
+    --env <key=value>+            set environment variables
+)raw";
+
+void PrintTable(const cmdline::Cmdline& cmd, const char* option)
+{
+    const cmdline::KeyValues* table = cmd.keyValues(option);
+    printf("%s:", option);
+    for (auto& pair : *table)
+        printf(" %s=%s(%d)", std::string(pair.key.b, pair.key.e).c_str(), pair.value, pair.arg);
+    printf("\n");
+}
+}
+
+AUTO_REGISTER(KeyValuePairs)
+{
+    printf("-------------------------------------------\n");
+    printf("KeyValuePairs\n");
+	int argc = 12;
+	char* argv[] = { "tool", "-c", "user.name=me", "--config=core.pager=less", "-c", "user.name=you",
+        "--define=DEBUG=1", "-D", "DEBUG=2", "--env", "A=1", "B=" };
+    PrintArgs(argc, argv);
+
+    cmdline::Cmdline cmd(KeyValueSpec);
+    cmd.eval(argc, argv);
+    printf("badArgs=%s\n", cmd.badArgs ? "true" : "false");
+    PrintTable(cmd, "config");
+    PrintTable(cmd, "define");
+    PrintTable(cmd, "env");
+
+    auto config = cmd.keyValues("c");
+    printf("user.name=%s core.pager=%s user.email=%s\n", config->find("user.name"), config->find("core.pager"),
+        config->find("user.email") ? config->find("user.email") : "<none>");
+    auto defines = cmd.keyValues("define")->all("DEBUG");
+    printf("DEBUG defined %d times, last %s\n", (int) (defines.second - defines.first), cmd.keyValues("define")->find("DEBUG"));
+    printf("not in the spec: %s\n", cmd.keyValues("verbose") == nullptr ? "null" : "table");
+
+    // An argument without '=' is an error
+    {
+        char* bad[] = { "tool", "-c", "user.name" };
+        cmd.eval(3, bad);
+        printf("bad: %s", cmd.errorMsg.c_str());
+    }
+    printf("\n");
+}
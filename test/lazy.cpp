@@ -0,0 +1,70 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/bind.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+int LookedUp(const cmdline::Cmdline& cmd)
+{
+    int n = 0;
+    if (cmd.lazy)
+        for (auto& t : cmd.lazy->tokens)
+            n += t.value != -2 ? 1 : 0;
+    return n;
+}
+}
+
+AUTO_REGISTER(LazyEval)
+{
+    printf("-------------------------------------------\n");
+    printf("LazyEval\n");
+
+    // A tool with a few hundred options, that usually only wants to know where to go
+    std::string text = "    <command>    what to run\n    <args>*\n    --help\n    --mode <mode>    where to route (default: local)\n    -j, --jobs <n:int>\n";
+    for (int i = 0; i < 300; i++)
+        text += "    --opt" + std::to_string(i) + " <value>\n";
+    std::vector<char> spec(text.begin(), text.end());
+    spec.push_back('\0');
+
+    int argc = 10;
+    char* argv[] = { "tool", "--mode=remote", "--opt7", "x", "build", "-j", "8", "--opt7=y", "--", "--help" };
+    PrintArgs(argc, argv);
+
+    cmdline::Cmdline cmd(argc, argv, spec.data(), cmdline::Cmdline::Lazy);
+    printf("indexed %d options, looked up %d\n", (int) cmd.lazy->tokens.size(), LookedUp(cmd));
+    // Every option in argv is looked up once, the first time it's passed
+    const char* mode = cmd["mode"].string();
+    printf("mode=%s looked up %d\n", mode, LookedUp(cmd));
+    bool help = cmd["help"].exists();
+    printf("help exists=%s looked up %d\n", help ? "true" : "false", LookedUp(cmd));
+    const int* jobs = cmd.typed<int>("jobs");
+    const char* opt7 = cmd["opt7"].string();
+    printf("jobs=%d opt7=%s lazy=%s\n", jobs != nullptr ? *jobs : -1, opt7, cmd.lazy ? "true" : "false");
+
+    // A positional needs the whole of argv, and then it's the same as an eager parse
+    const char* command = cmd["command"].string();
+    printf("command=%s lazy=%s\n", command, cmd.lazy ? "true" : "false");
+    cmdline::Cmdline eager(argc, argv, spec.data());
+    printf("same state=%s\n", cmd.state() == eager.state() ? "true" : "false");
+
+    // Lookups stop at an unknown option, as eval() does
+    char* bad[] = { "tool", "--nope", "--mode", "fast" };
+    cmdline::Cmdline unknown(4, bad, spec.data(), cmdline::Cmdline::Lazy);
+    printf("after unknown: mode=%s exists=%s\n", unknown["mode"].string(), unknown["mode"].exists() ? "true" : "false");
+    unknown.complete();
+    printf("complete: badArgs=%s %s", unknown.badArgs ? "true" : "false", unknown.errorMsg.c_str());
+
+    // An argument that looks like an unknown option but belongs to the one before it
+    // doesn't stop the lookups
+    char small[] = "    -o <file>    where to write\n    -v           say more\n";
+    char* weird[] = { "tool", "-o", "--weird", "-v" };
+    cmdline::Cmdline taken(4, weird, small, cmdline::Cmdline::Lazy);
+    printf("taken: verbose=%s output=%s lazy=%s\n", taken["v"].string(), taken["o"].string(), taken.lazy ? "true" : "false");
+    printf("\n");
+}
@@ -0,0 +1,49 @@
+#include "cmdline/cmdline.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <vector>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace {
+
+char* tenantSpec = R"raw(
+usage: serve [<options>] <root>
+
+    <root>                directory to serve
+
+    -p, --port <port>     port to listen on
+    -v, --verbose         be more verbose
+)raw";
+
+cmdline::Cmdline MakeTenant(int argc, char** argv)
+{
+    cmdline::Cmdline cmd(tenantSpec);
+    cmd.eval(argc, argv);
+    return cmd;
+}
+
+}
+
+AUTO_REGISTER(MoveOnlyCmdline)
+{
+    printf("-------------------------------------------\n");
+    printf("MoveOnlyCmdline\n");
+	int argc = 4;
+	char* argv[] = { "serve", "--port=8080", "-v", "/srv/www" };
+    PrintArgs(argc, argv);
+
+    // Parsers are built in a factory and kept by value, one per tenant
+    std::vector<cmdline::Cmdline> tenants;
+    for (int t = 0; t < 8; t++)
+        tenants.push_back(MakeTenant(argc, argv));
+
+    const cmdline::Cmdline& cmd = tenants.back();
+    printf("sizeof(Cmdline)=%d\n", (int) sizeof(cmdline::Cmdline));
+    printf("footprint=%d\n", (int) cmd.footprint());
+    printf("port=%s\n", cmd["port"].string());
+    printf("verbose=%s\n", cmd["v"].string());
+    printf("root=%s\n", cmd["root"].string());
+
+    printf("\n");
+}
@@ -0,0 +1,116 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/result.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+char NargsSpec[] = R"raw(
+usage: plot [<options>] <output> [<inputs>*]
+
+    <output>                   image to write
+    <inputs>                   data files to plot
+
+    -s, --size <w> <h>         image size
+    -c, --colors <c>+          one or more colors
+    -l, --labels <l>*          any number of labels
+    -t, --title <t>?           title, or a default one if none is given
+    -r, --range <r>{2,3}       axis range, with an optional step
+)raw";
+
+void PrintValue(const char* name, const cmdline::Value& v)
+{
+    printf("%s:", name);
+    if (!v.exists())
+        printf(" <none>");
+    for (auto a : v.args())
+        printf(" %s", a);
+    printf(" (%d)\n", v.count());
+}
+
+void Run(int argc, char* argv[])
+{
+    PrintArgs(argc, argv);
+
+    cmdline::Cmdline cmd(NargsSpec);
+    cmd.eval(argc, argv);
+    if (cmd.failed || cmd.badArgs)
+        printf("errors: %s", cmd.errorMsg.c_str());
+
+    PrintValue("size", cmd["size"]);
+    PrintValue("colors", cmd["colors"]);
+    PrintValue("labels", cmd["labels"]);
+    PrintValue("title", cmd["title"]);
+    PrintValue("range", cmd["range"]);
+    PrintValue("output", cmd["output"]);
+    PrintValue("inputs", cmd["inputs"]);
+
+    // Results keep every argument
+    auto result = cmd.freeze();
+    PrintValue("frozen colors", (*result)["colors"]);
+    printf("\n");
+}
+}
+
+AUTO_REGISTER(NargsRanges)
+{
+    printf("-------------------------------------------\n");
+    printf("NargsRanges\n");
+
+    {
+        // Each option takes values until the next option it knows about; -t takes
+        // out.png, since ? is as greedy as the rest
+        char* argv[] = { "plot", "-s", "640", "480", "--colors", "red", "green", "blue", "-l", "-t", "out.png", "a.dat", "b.dat" };
+        Run(13, argv);
+    }
+    {
+        // --opt=value starts the list, and -- ends it
+        char* argv[] = { "plot", "--colors=red", "green", "-r", "0", "10", "2", "--", "out.png", "-a.dat" };
+        Run(10, argv);
+    }
+    {
+        // Too few values
+        char* argv[] = { "plot", "-r", "0", "-c", "red", "out.png" };
+        Run(6, argv);
+    }
+    {
+        char* argv[] = { "plot", "-s", "640", "out.png" };
+        Run(4, argv);
+    }
+}
+
+// Bounded repeats in usage lines take exactly as many arguments as they say
+AUTO_REGISTER(NargsUsageBounds)
+{
+    printf("-------------------------------------------\n");
+    printf("NargsUsageBounds\n");
+
+    char* spec = R"raw(
+usage: join <pair>{2} <more>{0,2} <out>
+
+    <pair>   two files to join
+    <more>   up to two more
+    <out>    where to write the join
+)raw";
+    for (int argc = 2; argc <= 7; argc++)
+    {
+        char* argv[] = { "join", "a", "b", "c", "d", "e", "f" };
+        cmdline::Cmdline cmd(argc, argv, spec);
+        printf("%d args: usage line=%d pair=%d more=%d out=%s\n", argc - 1, cmd.usageLine(),
+            cmd["pair"].count(), cmd["more"].count(), cmd["out"].string());
+    }
+
+    // {10} is ten, not one; {0} is none; and bounds too big to write out are rejected
+    char* argv[] = { "run", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10" };
+    cmdline::Cmdline ten(11, argv, "usage: run <n>{10}\n\n<n>  a number\n");
+    cmdline::Cmdline one(2, argv, "usage: run <n>{10}\n\n<n>  a number\n");
+    cmdline::Cmdline none(1, argv, "usage: run <n>{0}\n\n<n>  a number\n");
+    cmdline::Cmdline big(1, argv, "usage: run <n>{1,1000}\n\n<n>  a number\n");
+    printf("{10} of 10: usage line=%d, of 1: usage line=%d\n", ten.usageLine(), one.usageLine());
+    printf("{0} of 0: usage line=%d\n", none.usageLine());
+    printf("{1,1000}: failed=%s\n", big.failed ? "true" : "false");
+
+    printf("\n");
+}
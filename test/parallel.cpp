@@ -0,0 +1,128 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/spec.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Logs every call as text, so two parses can be compared
+class LoggingSink : public cmdline::internal::SpecSink
+{
+public:
+    int value(bool named) override
+    {
+        log += named ? "value named\n" : "value positional\n";
+        return numValues++;
+    }
+    bool positional(cmdline::Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        log += "positional " + std::string(name.b, name.e) + " " + std::to_string(v) + " " + std::to_string(minArgs) + " " + std::to_string(maxArgs) + "\n";
+        return true;
+    }
+    bool named(cmdline::Fragment name, int v, int minArgs, int maxArgs) override
+    {
+        log += "named " + std::string(name.b, name.e) + " " + std::to_string(v) + " " + std::to_string(minArgs) + " " + std::to_string(maxArgs) + "\n";
+        return true;
+    }
+    bool usage(cmdline::Fragment section) override
+    {
+        log += "usage " + std::to_string(section.e - section.b) + "\n";
+        return true;
+    }
+    bool annotation(int v, cmdline::Fragment key, cmdline::Fragment body) override
+    {
+        log += "annotation " + std::to_string(v) + " " + std::string(key.b, key.e) + " " + std::string(body.b, body.e) + "\n";
+        return true;
+    }
+
+    std::string log;
+    int numValues = 0;
+};
+
+// A generated spec, the kind a tool with a few thousand subcommand flags might have,
+// with usage sections and positionals all through it
+std::string BigSpec(int options, bool usage)
+{
+    std::string spec = usage ? "usage: big [<options>] <input>\n       big --list\n\n" : "";
+    for (int i = 0; i < options; i++)
+    {
+        std::string n = std::to_string(i);
+        if (usage && i % 1000 == 500)
+            spec += "usage: big mode" + n + " [<options>]\n  -x, --opt" + n + "\n\n";
+        if (i % 7 == 0)
+            spec += "    -o" + n + ", --option-" + n + " <value>    set option " + n + " (default: " + n + ")\n";
+        else if (i % 7 == 1)
+            spec += "    [--flag-" + n + "]             turn on flag " + n + "\n        which has\n        a long description\n";
+        else if (i % 7 == 2)
+            spec += "    <input" + n + ">                  positional " + n + "\n";
+        else
+            spec += "    --opt" + n + " <a> <b>*           takes some values\n";
+    }
+    return spec;
+}
+}
+
+AUTO_REGISTER(ParallelStudy)
+{
+    printf("-------------------------------------------\n");
+    printf("ParallelStudy\n");
+
+    // Every option is declared twice, so the second half of the spec redeclares names
+    // from chunks parsed on other threads
+    std::string spec = BigSpec(20000, true);
+    spec += BigSpec(20000, true);
+    const char* b = spec.data();
+    const char* e = b + spec.size();
+
+    LoggingSink serial;
+    bool serialOk = cmdline::internal::study(b, e, serial);
+    for (int threads : { 2, 4, 7 })
+    {
+        LoggingSink parallel;
+        bool parallelOk = cmdline::internal::studyParallel(b, e, parallel, threads);
+        printf("%d threads: parsed=%s/%s values=%s calls=%s\n", threads,
+            serialOk ? "true" : "false", parallelOk ? "true" : "false",
+            serial.numValues == parallel.numValues ? "same" : "different",
+            serial.log == parallel.log ? "same" : "different");
+    }
+
+    // A syntax error stops both at the same place
+    std::string broken = BigSpec(20000, true);
+    broken.insert(broken.size() / 2, "\n    --oops <unclosed\n");
+    LoggingSink serialBroken;
+    LoggingSink parallelBroken;
+    bool a = cmdline::internal::study(broken.data(), broken.data() + broken.size(), serialBroken);
+    bool c = cmdline::internal::studyParallel(broken.data(), broken.data() + broken.size(), parallelBroken, 4);
+    printf("broken: parsed=%s/%s calls=%s\n", a ? "true" : "false", c ? "true" : "false",
+        serialBroken.log == parallelBroken.log ? "same" : "different");
+
+    // Synonyms that go on to the next line after a comma are never split apart. The
+    // first lines are long, so the splits land in them.
+    std::string wrapped;
+    for (int i = 0; i < 2000; i++)
+        wrapped += "    -Z" + std::to_string(i) + "," + std::string(200, ' ') + "\n        --zeta" + std::to_string(i) + "    takes Z\n";
+    LoggingSink serialWrapped;
+    cmdline::internal::study(wrapped.data(), wrapped.data() + wrapped.size(), serialWrapped);
+    for (int threads : { 2, 3, 4 })
+    {
+        LoggingSink parallelWrapped;
+        cmdline::internal::studyParallel(wrapped.data(), wrapped.data() + wrapped.size(), parallelWrapped, threads);
+        printf("wrapped synonyms, %d threads: values=%d/%d calls=%s\n", threads, serialWrapped.numValues,
+            parallelWrapped.numValues, serialWrapped.log == parallelWrapped.log ? "same" : "different");
+    }
+
+    // And through a Cmdline, which picks the thread count itself
+    spec = BigSpec(40000, false);
+    std::vector<char> text(spec.begin(), spec.end());
+    text.push_back('\0');
+    cmdline::Cmdline cmd(text.data());
+    char* argv[] = { "big", "--option-19999", "x", "--flag-8", "in" };
+    cmd.eval(5, argv);
+    printf("cmdline: failed=%s badArgs=%s\n", cmd.failed ? "true" : "false", cmd.badArgs ? "true" : "false");
+    printf("option-19999=%s o19999=%s flag-8=%s option-7=%s input2=%s\n", cmd["option-19999"].string(),
+        cmd["o19999"].string(), cmd["flag-8"].string(), cmd["option-7"].string(), cmd["input2"].string());
+    printf("\n");
+}
@@ -9,3 +9,7 @@ project 'test-cmdline'
     {
         'bf',
     }
+
+    filter { 'system:linux' }
+        links { 'pthread' }
+    filter {}
@@ -0,0 +1,131 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/procscan.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern std::atomic<int> allocations; // see fixed.cpp
+
+#if !defined(_WIN32)
+namespace
+{
+// A fake /proc, with a cmdline file per process
+void AddProcess(const std::string& root, int pid, const std::string& cmdline)
+{
+    std::string dir = root + "/" + std::to_string(pid);
+    mkdir(dir.c_str(), 0700);
+    FILE* f = fopen((dir + "/cmdline").c_str(), "wb");
+    fwrite(cmdline.data(), 1, cmdline.size(), f);
+    fclose(f);
+}
+}
+
+AUTO_REGISTER(ProcCmdlines)
+{
+    printf("-------------------------------------------\n");
+    printf("ProcCmdlines\n");
+
+    // Straight from a buffer, including one with no nul after the last argument
+    char spec[] = R"raw(
+        <src> <dest>          what to copy, and where
+        -a, --archive         keep everything
+        -e, --rsh <command>   remote shell to use
+    )raw";
+    cmdline::Cmdline cmd(spec);
+    char buffer[] = "rsync\0-a\0--rsh=ssh -p 22\0src/\0host:dest/\0";
+    cmd.eval(buffer, sizeof(buffer) - 1);
+    printf("badArgs=%s archive=%s rsh=%s src=%s dest=%s\n", cmd.badArgs ? "true" : "false", cmd["archive"].string(),
+        cmd["rsh"].string(), cmd["src"].string(), cmd["dest"].string());
+
+    // Each eval starts over, so nothing carries from one command line to the next
+    char bad[] = "rsync\0--bogus\0a\0b\0";
+    cmd.eval(bad, sizeof(bad) - 1);
+    printf("bad: badArgs=%s errors=%s", cmd.badArgs ? "true" : "false", cmd.errorMsg.c_str());
+    char plain[] = "rsync\0x/\0y/\0";
+    cmd.eval(plain, sizeof(plain) - 1);
+    printf("plain: badArgs=%s errors=%zu archive=%s rsh=%s src=%s dest=%s\n", cmd.badArgs ? "true" : "false", cmd.errorMsg.size(),
+        cmd["archive"].string(), cmd["rsh"].exists() ? cmd["rsh"].string() : "(none)", cmd["src"].string(), cmd["dest"].string());
+
+    // Long option names are looked up without building strings, so a parser that has
+    // seen a command line once parses it again without allocating
+    char longSpec[] = "    --compress-level <n>    how hard to try\n    --delete-after-transfer\n    <src>\n";
+    cmdline::Cmdline longNames(longSpec);
+    char longArgs[] = "rsync\0--compress-level=9\0--delete-after-transfer\0src/\0";
+    longNames.eval(longArgs, sizeof(longArgs) - 1);
+    int before = allocations;
+    longNames.eval(longArgs, sizeof(longArgs) - 1);
+    printf("long names: level=%s allocations=%d\n", longNames["compress-level"].string(), allocations - before);
+
+    char dir[] = "/tmp/cmdline-procXXXXXX";
+    std::string root = mkdtemp(dir);
+    std::vector<int> made;
+    for (int pid = 100; pid < 400; pid++)
+    {
+        if (pid % 3 == 0)
+            AddProcess(root, pid, std::string("/usr/bin/rsync\0-a\0src", 21) + std::to_string(pid) + std::string("\0dest\0", 6));
+        else if (pid % 3 == 1)
+            AddProcess(root, pid, std::string("ssh\0-l\0user", 11) + std::to_string(pid)); // unterminated
+        else
+            AddProcess(root, pid, std::string("bash\0-l\0", 8));
+        made.push_back(pid);
+    }
+    AddProcess(root, 400, ""); // a kernel thread
+    mkdir((root + "/self").c_str(), 0700);
+
+    cmdline::ProcScanner scanner(root.c_str());
+    int rsync = scanner.add("rsync", spec);
+    scanner.add("ssh", "    -l <login>    user to log in as\n    <host>\n");
+
+    std::mutex mutex;
+    std::vector<std::string> seen;
+    int parsed = scanner.scan([&](const cmdline::ProcScanner::Process& p) {
+        char line[128];
+        if (p.tool == rsync)
+            snprintf(line, sizeof(line), "%d rsync src=%s", p.pid, (*p.cmd)["src"].string());
+        else
+            snprintf(line, sizeof(line), "%d ssh login=%s badArgs=%s", p.pid, (*p.cmd)["l"].string(), p.cmd->badArgs ? "true" : "false");
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.push_back(line);
+    }, 4);
+    std::sort(seen.begin(), seen.end());
+    printf("parsed=%d errors=%s\n", parsed, scanner.errors().empty() ? "none" : scanner.errors().c_str());
+    for (size_t i = 0; i < 4; i++)
+        printf("%s\n", seen[i].c_str());
+
+    // Scanning again reuses the workers' buffers and parsers, so once a worker has
+    // seen every tool the only allocation is the scan's own bookkeeping
+    scanner.scan([](const cmdline::ProcScanner::Process&) {}, 1);
+    before = allocations;
+    int again = scanner.scan([](const cmdline::ProcScanner::Process&) {}, 1);
+    printf("again: parsed=%d allocations=%d\n", again, allocations - before);
+
+    // A bad spec is reported once, however many times add() makes the workers again
+    scanner.add("broken", "    --go    (action: launch)\n");
+    scanner.scan([](const cmdline::ProcScanner::Process&) {}, 1);
+    scanner.add("tar", "    -x    extract\n");
+    scanner.scan([](const cmdline::ProcScanner::Process&) {}, 1);
+    printf("spec errors: %s", scanner.errors().c_str());
+
+    for (int pid : made)
+    {
+        unlink((root + "/" + std::to_string(pid) + "/cmdline").c_str());
+        rmdir((root + "/" + std::to_string(pid)).c_str());
+    }
+    unlink((root + "/400/cmdline").c_str());
+    rmdir((root + "/400").c_str());
+    rmdir((root + "/self").c_str());
+    rmdir(root.c_str());
+    printf("\n");
+}
+#endif
@@ -0,0 +1,61 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/registry.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+// As two translation units would declare them, in a registry of their own so other
+// tests' fragments don't mix in
+cmdline::SpecRegistry& Registry()
+{
+    static cmdline::SpecRegistry registry;
+    return registry;
+}
+
+cmdline::SpecFragment serverOptions(R"raw(
+    -p, --port <port:int>     port to listen on (default: 8080)
+    --backlog <n:int>         listen queue length (default: 128)
+)raw", Registry());
+
+cmdline::SpecFragment logOptions(R"raw(
+    --log-level <level>       how much to log (default: info)
+    -q, --quiet               log nothing
+)raw", Registry());
+}
+
+AUTO_REGISTER(SpecFragments)
+{
+    printf("-------------------------------------------\n");
+    printf("SpecFragments\n");
+
+    int argc = 4;
+    char* argv[] = { "server", "-q", "--port=9000", "site" };
+    PrintArgs(argc, argv);
+
+    auto merged = Registry().merged();
+    printf("same group=%s failed=%s options=%d\n", Registry().merged() == merged ? "true" : "false",
+        merged->failed() ? "true" : "false", (int) merged->names().size());
+
+    cmdline::SpecFragment late("    --late    registered after the merge\n", Registry());
+    const char late_[] = "late";
+    printf("late in group=%s\n", merged->find(late_, late_ + 4) != nullptr ? "true" : "false");
+
+    char spec[] = "    <root>    directory to serve\n";
+    cmdline::Cmdline cmd(spec);
+    cmd.include(merged);
+    cmd.eval(argc, argv);
+    printf("badArgs=%s root=%s port=%s backlog=%s log-level=%s quiet=%s\n", cmd.badArgs ? "true" : "false",
+        cmd["root"].string(), cmd["port"].string(), cmd["backlog"].string(), cmd["log-level"].string(), cmd["quiet"].string());
+
+    // Two fragments that both declare -q
+    cmdline::SpecRegistry clashing;
+    cmdline::SpecFragment a("    -q, --quiet    log nothing\n", clashing);
+    cmdline::SpecFragment b("    -q, --query <text>    search for text\n", clashing);
+    auto failed = clashing.merged();
+    printf("clashing: failed=%s %s", failed->failed() ? "true" : "false", failed->errors().c_str());
+    printf("\n");
+}
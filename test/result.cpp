@@ -0,0 +1,144 @@
+#include "cmdline/result.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <thread>
+#include <vector>
+extern void PrintArgs(int argc, char* argv[]);
+
+AUTO_REGISTER(FrozenResult)
+{
+    printf("-------------------------------------------\n");
+    printf("FrozenResult\n");
+	int argc = 4;
+	char* argv[] = { "git-clone", "-q", "--depth=1", "git@github.com:neurocline/cmdline.git" };
+    PrintArgs(argc, argv);
+
+    std::shared_ptr<const cmdline::Result> result;
+    {
+        cmdline::Cmdline cmd(argc, argv, R"raw(
+usage: git clone [<options>] [--] <repository>
+
+    <repository>          location of upstream repo
+
+    -v, --verbose         be more verbose
+    -q, --quiet           be more quiet
+    --depth <depth>       create a shallow clone of that depth
+)raw");
+        result = cmd.freeze();
+    }
+
+    // Read the same result from several threads; the Cmdline is already gone
+    std::atomic<int> mismatches{ 0 };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++)
+    {
+        workers.emplace_back([result, &mismatches]() {
+            for (int i = 0; i < 1000; i++)
+            {
+                if (!(*result)["quiet"].exists() || (*result)["verbose"].exists())
+                    mismatches++;
+                if (strcmp((*result)["depth"].string(), "1") != 0)
+                    mismatches++;
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    printf("result size=%d bytes\n", (int) result->size());
+    printf("mismatches=%d\n", mismatches.load());
+    for (int i = 0; i < result->positionals(); i++)
+        printf("positional %s=%s\n", result->positional(i), (*result)[result->positional(i)].string());
+    printf("q=%s depth=%s\n", (*result)["q"].string(), (*result)["depth"].string());
+
+    printf("\n");
+}
+
+AUTO_REGISTER(AdoptedResult)
+{
+    printf("-------------------------------------------\n");
+    printf("AdoptedResult\n");
+	int argc = 6;
+	char* argv[] = { "supervisor", "--jobs=8", "work.db", "--listen", "a:80", "b:81" };
+    PrintArgs(argc, argv);
+
+    cmdline::Cmdline cmd(argc, argv, R"raw(
+    <db>                  database to serve
+    -j, --jobs <n>        worker count
+    -l, --listen <addr>+  addresses to listen on
+)raw");
+    auto result = cmd.freeze();
+
+    auto show = [](const char* how, const std::shared_ptr<const cmdline::Result>& r) {
+        if (!r)
+        {
+            printf("%s: null\n", how);
+            return;
+        }
+        auto listen = (*r)["listen"];
+        printf("%s: jobs=%s db=%s listen=", how, (*r)["jobs"].string(), (*r)["db"].string());
+        for (auto a : listen.args())
+            printf("%s ", a);
+        printf("\n");
+    };
+
+    // Adopting a copy in place, as a worker would with shared memory
+    std::vector<uint32_t> shared((result->size() + 3) / 4);
+    memcpy(shared.data(), result->data(), result->size());
+    auto adopted = cmdline::Result::adopt(shared.data(), result->size());
+    show("adopt", adopted);
+    printf("zero-copy=%s\n", adopted->data() == (const char*) shared.data() ? "true" : "false");
+
+    // A truncated or corrupt block is refused
+    show("truncated", cmdline::Result::adopt(shared.data(), result->size() - 1));
+    shared[0] ^= 1;
+    show("bad magic", cmdline::Result::adopt(shared.data(), result->size()));
+    shared[0] ^= 1;
+
+    // So is one with an offset that points outside it. Entries are 8 words, after an
+    // 8-word header, and an entry's name, str, count and rest are words 0, 1, 4 and 5.
+    uint32_t size = (uint32_t) result->size();
+    int listen = 8;
+    while (shared[listen + 4] < 2)
+        listen += 8;
+    struct { const char* how; int word; uint32_t value; } corrupt[] = {
+        { "null name", 8, 0 },
+        { "name past end", 8, size },
+        { "string in header", 9, 4 },
+        { "rest past end", listen + 5, size },
+        { "count past rest", listen + 4, 1000 },
+    };
+    for (auto& c : corrupt)
+    {
+        uint32_t was = shared[c.word];
+        shared[c.word] = c.value;
+        show(c.how, cmdline::Result::adopt(shared.data(), size));
+        shared[c.word] = was;
+    }
+    show("restored", cmdline::Result::adopt(shared.data(), size));
+
+#if !defined(_WIN32)
+    // Through a file, which is mapped, and a pipe, which has to be read
+    FILE* f = tmpfile();
+    result->write(fileno(f));
+    show("file", cmdline::Result::map(fileno(f)));
+    fclose(f);
+
+    int fds[2];
+    if (pipe(fds) == 0)
+    {
+        result->write(fds[1]);
+        close(fds[1]);
+        show("pipe", cmdline::Result::map(fds[0]));
+        close(fds[0]);
+    }
+#endif
+
+    printf("\n");
+}
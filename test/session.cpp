@@ -0,0 +1,142 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/session.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+
+extern std::atomic<int> allocations; // see fixed.cpp
+
+namespace
+{
+char SessionSpec[] = R"raw(
+usage: render [<options>] <scene> [<output>]
+
+    <scene>               scene to render
+    <output>              image to write
+
+    -s, --size <w> <h>    image size
+    -l, --lights <l>*     lights to enable
+    -q, --quality <q>     sample count
+    -v, --verbose         be more verbose
+)raw";
+
+const char* Names[] = { "scene", "output", "size", "lights", "quality", "verbose" };
+
+// Describe the values, so an incremental parse can be compared with a fresh one
+std::string Describe(const cmdline::Cmdline& cmd, const cmdline::Session& session)
+{
+    std::string s;
+    for (auto name : Names)
+    {
+        auto& v = cmd[name];
+        s += name;
+        s += "=";
+        for (auto a : v.args())
+            s += std::string(a) + ",";
+        s += " ";
+    }
+    s += session.error() != nullptr ? session.error() : "ok";
+    return s;
+}
+
+std::string Fresh(const std::string& line)
+{
+    cmdline::Cmdline cmd(SessionSpec);
+    cmdline::Session session(cmd);
+    session.update(line.data(), line.size());
+    return Describe(cmd, session);
+}
+}
+
+AUTO_REGISTER(IncrementalSession)
+{
+    printf("-------------------------------------------\n");
+    printf("IncrementalSession\n");
+
+    cmdline::Cmdline cmd(SessionSpec);
+    cmdline::Session session(cmd);
+
+    // Type a line one key at a time, checking every step against a full parse
+    std::string line = "-v scene.obj -s 640 480 --lights key fill -q 64 out.png";
+    std::string typed;
+    int mismatches = 0;
+    int reparsed = 0;
+    for (char c : line)
+    {
+        typed += c;
+        session.update(typed.data(), typed.size());
+        reparsed += session.reparsed();
+        if (Describe(cmd, session) != Fresh(typed))
+            mismatches += 1;
+    }
+    printf("typed %d keys, reparsed %d arguments, mismatches=%d\n", (int) line.size(), reparsed, mismatches);
+    printf("%s\n", Describe(cmd, session).c_str());
+
+    // Edits in the middle, including ones that turn a value into an option and back
+    struct { size_t at; size_t erase; const char* text; } edits[] = {
+        { 13, 2, "--size" },  // -s becomes --size
+        { 41, 0, "-v " },     // lights stop at -v
+        { 41, 3, "" },        // and take fill again
+        { 3, 10, "" },        // drop the scene
+        { 0, 0, "bogus " },   // an extra positional
+        { 0, 6, "--nope " },  // an unknown option
+    };
+    for (auto& e : edits)
+    {
+        std::string expected = typed;
+        expected.replace(e.at, e.erase, e.text);
+        session.edit(e.at, e.erase, e.text, strlen(e.text));
+        typed = expected;
+        bool same = Describe(cmd, session) == Fresh(typed);
+        printf("'%s': reparsed %d, %s\n", typed.c_str(), session.reparsed(), same ? "same" : "DIFFERENT");
+        if (session.error() != nullptr)
+            printf("  error at %d: %s\n", session.errorArg(), session.error());
+    }
+
+    // Once storage has grown to fit, editing doesn't allocate
+    int before = allocations;
+    for (int k = 0; k < 100; k++)
+    {
+        session.edit(typed.size(), 0, " x", 2);
+        session.edit(typed.size(), 2, "", 0);
+    }
+    printf("allocations=%d\n", allocations - before);
+
+    printf("\n");
+}
+
+// Clusters and flag actions parse as they do in eval(), and edits undo counts
+AUTO_REGISTER(SessionClusters)
+{
+    printf("-------------------------------------------\n");
+    printf("SessionClusters\n");
+
+    char spec[] = R"raw(
+    <files>*
+    -v              more output (action: count)
+    -q              less output (action: store_false)
+    -x              extract
+    -f <archive>    the archive
+)raw";
+    cmdline::Cmdline cmd(spec);
+    cmdline::Session session(cmd);
+    auto show = [&](const char* line) {
+        session.update(line, strlen(line));
+        printf("%-16s v=%s q=%s x=%s f=%s files=%d %s\n", line, cmd["v"].string(), cmd["q"].string(), cmd["x"].string(),
+            cmd["f"].exists() ? cmd["f"].string() : "-", cmd["files"].count(), session.error() != nullptr ? session.error() : "ok");
+    };
+    show("-vvv -xf a.tar");
+    show("-vvv -xf a.tar -q");
+    show("-vv -xf a.tar");
+    show("-v -v b");
+    show("-v -q b");
+
+    cmdline::Cmdline eager(spec);
+    char* argv[] = { "tar", "-vvv", "-xf", "a.tar", "-q" };
+    eager.eval(5, argv);
+    printf("eval: v=%s q=%s x=%s f=%s\n", eager["v"].string(), eager["q"].string(), eager["x"].string(), eager["f"].string());
+    printf("\n");
+}
@@ -0,0 +1,74 @@
+#include "cmdline/stream.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+extern void PrintArgs(int argc, char* argv[]);
+
+#if defined(_WIN32)
+#define fileno _fileno
+#endif
+
+AUTO_REGISTER(StreamNulArgs)
+{
+    printf("-------------------------------------------\n");
+    printf("StreamNulArgs\n");
+
+    // 1000 NUL-separated paths, read back through a buffer that holds only a few
+    FILE* f = tmpfile();
+    for (int i = 0; i < 1000; i++)
+        fprintf(f, "dir/file-%d.txt%c", i, '\0');
+    fputs("last-without-terminator", f);
+    fflush(f);
+    rewind(f);
+
+    cmdline::ArgStream in(fileno(f), '\0', 64);
+    std::string last;
+    size_t n = in.forEach([&last](const char* arg) { last = arg; });
+    printf("count=%d failed=%s\n", (int) n, in.failed() ? "true" : "false");
+    printf("last=%s\n", last.c_str());
+    fclose(f);
+
+    // An argument longer than the buffer is an error
+    f = tmpfile();
+    fputs("this-argument-is-too-long-for-the-buffer", f);
+    fputc('\0', f);
+    fflush(f);
+    rewind(f);
+
+    cmdline::ArgStream tiny(fileno(f), '\0', 16);
+    n = tiny.forEach([](const char*) {});
+    printf("count=%d failed=%s\n", (int) n, tiny.failed() ? "true" : "false");
+    fclose(f);
+
+    // But an argument that exactly fills the buffer is fine, last or not
+    static const struct { const char* tail; size_t len; } tails[] = { { "", 0 }, { "\0next", 5 } };
+    for (auto& t : tails)
+    {
+        f = tmpfile();
+        fputs("exactly-16-bytes", f);
+        fwrite(t.tail, 1, t.len, f);
+        fflush(f);
+        rewind(f);
+
+        cmdline::ArgStream exact(fileno(f), '\0', 16);
+        n = exact.forEach([](const char* arg) { printf("arg=%s\n", arg); });
+        printf("count=%d failed=%s\n", (int) n, exact.failed() ? "true" : "false");
+        fclose(f);
+    }
+
+    // A positional that isn't "-" streams just itself
+	int argc = 2;
+	char* argv[] = { "wc", "notes.txt" };
+    PrintArgs(argc, argv);
+	cmdline::Cmdline cmd(argc, argv, R"raw(
+usage: wc <file>
+
+    <file>    file to count, or - to read NUL-separated paths from stdin
+)raw");
+    n = cmdline::streamArgs(cmd["file"], '\0', [](const char* path) { printf("file=%s\n", path); });
+    printf("count=%d\n", (int) n);
+
+    printf("\n");
+}
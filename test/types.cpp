@@ -0,0 +1,204 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/types.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace
+{
+struct Duration { long long ms; };
+struct Endpoint { std::string host; int port; };
+struct Unit { char unit; unsigned long long size; };
+const Unit Units[] = { { 'K', 1ull << 10 }, { 'M', 1ull << 20 }, { 'G', 1ull << 30 } };
+
+// 250ms, 30s, 5m
+bool ParseDuration(const char* str, Duration& out)
+{
+    char* end;
+    long long n = strtoll(str, &end, 10);
+    if (end == str)
+        return false;
+    if (strcmp(end, "ms") == 0) out.ms = n;
+    else if (strcmp(end, "s") == 0) out.ms = n * 1000;
+    else if (strcmp(end, "m") == 0) out.ms = n * 60000;
+    else return false;
+    return true;
+}
+
+bool ParseEndpoint(const char* str, Endpoint& out)
+{
+    const char* colon = strrchr(str, ':');
+    if (colon == nullptr || colon == str)
+        return false;
+    out.host.assign(str, colon);
+    out.port = atoi(colon + 1);
+    return out.port > 0 && out.port < 65536;
+}
+
+char TypesSpec[] = R"raw(
+    <listen:endpoint>         address to listen on
+    -t, --timeout <t:duration>
+                              how long to wait (default: 30s)
+    --cache <size:bytes>      cache size
+    -j, --jobs <n:int>        worker count (default: 4)
+    -v, --verbose <:bool>     be more verbose
+)raw";
+}
+
+AUTO_REGISTER(TypedValues)
+{
+    printf("-------------------------------------------\n");
+    printf("TypedValues\n");
+
+    // A lambda can capture a pointer, here to a table of unit sizes
+    const Unit* table = Units;
+
+    cmdline::Converters types;
+    types.add<Duration>("duration", ParseDuration);
+    types.add<Endpoint>("endpoint", ParseEndpoint);
+    types.add<unsigned long long>("bytes", [table](const char* str, unsigned long long& out) {
+        char* end;
+        out = strtoull(str, &end, 10);
+        for (int i = 0; i < 3; i++)
+            if (*end == table[i].unit && end[1] == '\0')
+                return out *= table[i].size, true;
+        return *end == '\0';
+    });
+
+    cmdline::Cmdline cmd(TypesSpec, types);
+    printf("failed=%s\n", cmd.failed ? "true" : "false");
+
+    auto show = [&cmd]() {
+        const Endpoint* listen = cmd.typed<Endpoint>("listen");
+        const Duration* timeout = cmd.typed<Duration>("timeout");
+        const unsigned long long* cache = cmd.typed<unsigned long long>("cache");
+        const int* jobs = cmd.typed<int>("j");
+        const bool* verbose = cmd.typed<bool>("verbose");
+        printf("badArgs=%s\n", cmd.badArgs ? "true" : "false");
+        if (cmd.badArgs)
+            printf("errors:\n%s", cmd.errorMsg.c_str());
+        printf("listen=");
+        if (listen) printf("%s port %d", listen->host.c_str(), listen->port); else printf("<none>");
+        printf(" timeout=");
+        if (timeout) printf("%lldms", timeout->ms); else printf("<none>");
+        printf(" cache=");
+        if (cache) printf("%llu", *cache); else printf("<none>");
+        printf(" jobs=%d verbose=%s\n", jobs ? *jobs : -1, verbose ? (*verbose ? "true" : "false") : "<none>");
+
+        // Asking for the wrong type gets nothing
+        printf("timeout as int: %s\n", cmd.typed<int>("timeout") ? "found" : "null");
+    };
+
+    {
+        char* argv[] = { "server", "--cache=64M", "-v", "-t", "250ms", "localhost:8080" };
+        PrintArgs(6, argv);
+        cmd.eval(6, argv);
+        show();
+    }
+    {
+        // Values that don't convert are command-line errors; defaults still apply
+        cmdline::Cmdline again(TypesSpec, types);
+        char* argv[] = { "server", "--jobs", "many", "--cache", "10X", "nowhere" };
+        PrintArgs(6, argv);
+        again.eval(6, argv);
+        std::swap(cmd, again);
+        show();
+    }
+
+    // Types that aren't registered make the spec fail, and without a registry only the
+    // built-in types are known
+    {
+        char spec[] = "    --wait <t:duration>    how long\n    -n <n:int>    count\n";
+        cmdline::Cmdline builtin(spec);
+        printf("builtin only: failed=%s %s", builtin.failed ? "true" : "false", builtin.errorMsg.c_str());
+    }
+    {
+        char spec[] = "    -n <n:int>    count (default: 0x10)\n";
+        cmdline::Cmdline builtin(spec);
+        char* argv[] = { "tool" };
+        builtin.eval(1, argv);
+        printf("builtin int default: %d\n", *builtin.typed<int>("n"));
+    }
+    printf("\n");
+}
+
+AUTO_REGISTER(TypedLists)
+{
+    printf("-------------------------------------------\n");
+    printf("TypedLists\n");
+
+    char spec[] = R"raw(
+    --ids <ids:int,>          ids to process
+    --shards <s:long,>        shards to own (default: 0-3)
+)raw";
+    cmdline::Cmdline cmd(spec);
+
+    auto show = [&cmd](const char* name) {
+        const std::vector<long long>* longs = cmd.typed<std::vector<long long>>(name);
+        const std::vector<int>* ints = cmd.typed<std::vector<int>>(name);
+        printf("%s:", name);
+        if (ints != nullptr)
+            for (int n : *ints)
+                printf(" %d", n);
+        if (longs != nullptr)
+            for (long long n : *longs)
+                printf(" %lld", n);
+        if (ints == nullptr && longs == nullptr)
+            printf(" <none>");
+        printf("\n");
+    };
+
+    {
+        char* argv[] = { "tool", "--ids", "7,-3,10-12,2147483647", "--shards=123456789012-123456789014,-9223372036854775808" };
+        PrintArgs(4, argv);
+        cmd.eval(4, argv);
+        printf("badArgs=%s\n", cmd.badArgs ? "true" : "false");
+        show("ids");
+        show("shards");
+    }
+
+    // Errors say where in the argument the problem is
+    const char* bad[] = { "1,2,,3", "1,2x", "5-3", "1,2147483648", "12345678901234567890123", "0-99999999", "1,", "-" };
+    for (auto list : bad)
+    {
+        std::vector<int> out;
+        const char* where = nullptr;
+        bool ok = cmdline::parseList(list, out, &where);
+        printf("%s: %s at byte %d\n", list, ok ? "ok" : "bad", ok ? -1 : (int) (where - list));
+    }
+    {
+        cmdline::Cmdline again(spec);
+        char* argv[] = { "tool", "--ids=1,2,3,4,5,6,7,8,9,10,11,12,x13,14,15,16,17,18,19,20,21" };
+        again.eval(2, argv);
+        printf("errors: %s", again.errorMsg.c_str());
+        std::swap(cmd, again);
+        show("shards");
+    }
+
+    // Long lists take the eight-digits-at-a-time path for most numbers; check it
+    // against strtoll for numbers of every length
+    std::string list;
+    std::vector<long long> expected;
+    unsigned long long seed = 12345;
+    for (int i = 0; i < 20000; i++)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        int digits = 1 + (int) ((seed >> 33) % 19);
+        std::string n = std::to_string((seed >> 1) % 9000000000000000000ull).substr(0, digits);
+        if (seed & 1)
+            n = "-" + n;
+        if (!list.empty())
+            list += ",";
+        list += n;
+        expected.push_back(strtoll(n.c_str(), nullptr, 10));
+    }
+    std::vector<long long> parsed;
+    const char* where = nullptr;
+    bool ok = cmdline::parseList(list.c_str(), parsed, &where);
+    printf("bulk: ok=%s count=%d matches=%s\n", ok ? "true" : "false", (int) parsed.size(), parsed == expected ? "true" : "false");
+    printf("\n");
+}
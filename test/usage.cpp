@@ -0,0 +1,208 @@
+#include "cmdline/cmdline.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+extern void PrintArgs(int argc, char* argv[]);
+
+namespace {
+
+char* cpSpec = R"raw(
+usage: cp [options] <source_file> <target_file>
+       cp [options] <source_file>... <target_directory>
+
+    Copy files
+
+    <source_file>       file to copy
+    <target_file>       where to copy it
+    <target_directory>  where to copy several files
+
+    -f, --force    overwrite without asking
+)raw";
+
+void PrintCp(int argc, char** argv)
+{
+    PrintArgs(argc, argv);
+	cmdline::Cmdline cmd(argc, argv, cpSpec);
+
+    printf("usage line=%d\n", cmd.usageLine());
+    if (cmd.badArgs)
+        printf("errors: %s", cmd.errorMsg.c_str());
+    printf("source_file=%s (%s)\n", cmd["source_file"].string(), cmd["source_file"].exists() ? "set" : "unset");
+    printf("target_file=%s\n", cmd["target_file"].exists() ? cmd["target_file"].string() : "<none>");
+    printf("target_directory=%s\n", cmd["target_directory"].exists() ? cmd["target_directory"].string() : "<none>");
+    printf("force=%s\n", cmd["force"].string());
+}
+
+}
+
+// The two forms of cp from docs/design.md
+AUTO_REGISTER(UsageTwoForms)
+{
+    printf("-------------------------------------------\n");
+    printf("UsageTwoForms\n");
+
+    char* two[] = { "cp", "a.txt", "b.txt" };
+    PrintCp(3, two);
+
+    char* many[] = { "cp", "-f", "a.txt", "b.txt", "c.txt", "backup" };
+    PrintCp(6, many);
+
+    char* one[] = { "cp", "a.txt" };
+    PrintCp(2, one);
+
+    printf("\n");
+}
+
+// The example from the README
+AUTO_REGISTER(UsageReadme)
+{
+    printf("-------------------------------------------\n");
+    printf("UsageReadme\n");
+	int argc = 3;
+	char* argv[] = { "blov", "--ingest=http://example.com", "out.txt" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(argc, argv, R"raw(
+Bloviate the argosphere
+
+usage: blov [<options>] <file>
+
+[--version]       show version number
+[--ingest=<url>]  augment default argosphere with contents of <url>
+<file>            path to write output of bloviation
+)raw");
+
+    printf("failed=%s badArgs=%s usage line=%d\n", cmd.failed ? "true" : "false",
+        cmd.badArgs ? "true" : "false", cmd.usageLine());
+    printf("version=%s\n", cmd["version"].string());
+    printf("ingest=%s\n", cmd["ingest"].string());
+    printf("file=%s\n", cmd["file"].string());
+
+    printf("\n");
+}
+
+// Commands, alternation and required options
+AUTO_REGISTER(UsageCommands)
+{
+    printf("-------------------------------------------\n");
+    printf("UsageCommands\n");
+	int argc = 4;
+	char* argv[] = { "remote", "add", "origin", "--url=git@example.com:x.git" };
+    PrintArgs(argc, argv);
+
+	cmdline::Cmdline cmd(argc, argv, R"raw(
+usage: remote add <name> --url=<url>
+       remote (rm | remove) <name>
+       remote [-v]
+
+    <name>         the remote
+    --url=<url>    where it is
+    -v             show urls
+)raw");
+
+    printf("usage line=%d badArgs=%s\n", cmd.usageLine(), cmd.badArgs ? "true" : "false");
+    printf("name=%s url=%s\n", cmd["name"].string(), cmd["url"].string());
+
+	char* argv2[] = { "remote", "add", "origin" };
+    PrintArgs(3, argv2);
+	cmdline::Cmdline cmd2(3, argv2, cmd.spec);
+    printf("usage line=%d errors: %s", cmd2.usageLine(), cmd2.errorMsg.c_str());
+
+    printf("\n");
+}
+
+// An error elsewhere in argv doesn't lose the positionals
+AUTO_REGISTER(UsageWithErrors)
+{
+    printf("-------------------------------------------\n");
+    printf("UsageWithErrors\n");
+
+    char bad[] = "a\xff.txt";
+    char* argv[] = { "cp", bad, "b.txt" };
+    PrintCp(3, argv);
+
+    char* argv2[] = { "cp", "a.txt", "b.txt", "-t" };
+	cmdline::Cmdline cmd(4, argv2, R"raw(
+usage: cp [options] <source_file> <target_file>
+
+    <source_file>   file to copy
+    <target_file>   where to copy it
+    -t <dir>        copy into dir
+)raw");
+    PrintArgs(4, argv2);
+    printf("usage line=%d errors: %s", cmd.usageLine(), cmd.errorMsg.c_str());
+    printf("source_file=%s target_file=%s\n", cmd["source_file"].string(), cmd["target_file"].string());
+
+    printf("\n");
+}
+
+// Words after the program name that name the program too, and names that aren't declared
+AUTO_REGISTER(UsageProgramWords)
+{
+    printf("-------------------------------------------\n");
+    printf("UsageProgramWords\n");
+
+    char* spec = R"raw(
+usage: git clone [<options>] [--] <repository> [<directory>]
+
+    <repository>    location of upstream repo
+    <directory>     local directory to clone into
+    -v, --verbose   be more verbose
+)raw";
+
+    char* builtin[] = { "/usr/libexec/git-core/git-clone", "-v", "url", "dir" };
+    char* wrapper[] = { "git", "clone", "url" };
+    char* other[] = { "git", "fetch", "url" };
+    struct { int argc; char** argv; } runs[] = { { 4, builtin }, { 3, wrapper }, { 3, other } };
+    for (auto& run : runs)
+    {
+        PrintArgs(run.argc, run.argv);
+        cmdline::Cmdline cmd(run.argc, run.argv, spec);
+        printf("usage line=%d badArgs=%s repository=%s directory=%s\n", cmd.usageLine(),
+            cmd.badArgs ? "true" : "false", cmd["repository"].string(), cmd["directory"].string());
+    }
+
+    char* argv[] = { "git-clone", "url" };
+    PrintArgs(2, argv);
+	cmdline::Cmdline cmd(2, argv, R"raw(
+usage: git clone [<options>] [--] <repo> [<dir>]
+
+    <repository>    location of upstream repo
+    -q              be quiet
+)raw");
+    printf("failed=%s usage line=%d repository=%s\n", cmd.failed ? "true" : "false", cmd.usageLine(),
+        cmd["repository"].string());
+    printf("errors: %s", cmd.errorMsg.c_str());
+    printf("repo declared=%s\n", cmd.lookup("repo") >= 0 ? "true" : "false");
+
+    printf("\n");
+}
+
+// Every flag in a cluster is checked against the usage line, not just the last
+AUTO_REGISTER(UsageClusteredFlags)
+{
+    printf("-------------------------------------------\n");
+    printf("UsageClusteredFlags\n");
+
+    char* spec = R"raw(
+usage: tool -x [-v] <file>
+
+    <file>    what to extract
+    -x        extract
+    -v        say more
+    -z        decompress
+)raw";
+
+    char* allowed[] = { "tool", "-vx", "a.tar" };
+    char* extra[] = { "tool", "-zx", "a.tar" };
+    struct { int argc; char** argv; } runs[] = { { 3, allowed }, { 3, extra } };
+    for (auto& run : runs)
+    {
+        PrintArgs(run.argc, run.argv);
+        cmdline::Cmdline cmd(run.argc, run.argv, spec);
+        printf("usage line=%d badArgs=%s %s", cmd.usageLine(), cmd.badArgs ? "true" : "false", cmd.errorMsg.c_str());
+        printf("file=%s\n", cmd["file"].string());
+    }
+
+    printf("\n");
+}
@@ -0,0 +1,80 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/utf8.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+extern void PrintArgs(int argc, char* argv[]);
+
+AUTO_REGISTER(Utf8Validation)
+{
+    printf("-------------------------------------------\n");
+    printf("Utf8Validation\n");
+
+    struct { const char* name; const char* bytes; } cases[] = {
+        { "ascii", "--output=file.txt" },
+        { "two-byte", "--caf\xc3\xa9" },
+        { "three-byte", "\xe2\x82\xac 100" },
+        { "four-byte", "\xf0\x9f\x98\x80" },
+        { "stray continuation", "ab\x80" },
+        { "overlong", "\xc0\xaf" },
+        { "surrogate", "\xed\xa0\x80" },
+        { "past U+10FFFF", "\xf4\x90\x80\x80" },
+        { "truncated", "abc\xe2\x82" },
+    };
+    for (auto& c : cases)
+    {
+        const char* bad = nullptr;
+        bool ok = cmdline::validUtf8(c.bytes, c.bytes + strlen(c.bytes), &bad);
+        printf("%s: %s", c.name, ok ? "valid" : "invalid");
+        if (!ok)
+            printf(" at %d", (int) (bad - c.bytes));
+        printf("\n");
+    }
+
+    // A long ASCII run with a bad byte near the end exercises the block paths
+    std::string longRun(1000, 'x');
+    longRun[997] = '\xff';
+    const char* bad = nullptr;
+    cmdline::validUtf8(longRun.data(), longRun.data() + longRun.size(), &bad);
+    printf("long run: bad at %d\n", (int) (bad - longRun.data()));
+
+    printf("\n");
+}
+
+AUTO_REGISTER(Utf8Options)
+{
+    printf("-------------------------------------------\n");
+    printf("Utf8Options\n");
+	int argc = 5;
+	char* argv[] = { "r\xc3\xa9sum\xc3\xa9", "--GR\xc3\x96SSE=12", "-\xc3\x89", "--Verbose", "DATEI.txt" };
+    PrintArgs(argc, argv);
+
+    // Written with escapes, since raw strings don't have them
+    char spec[] =
+        "usage: r\xc3\xa9sum\xc3\xa9 [<options>] <Datei>\n"
+        "\n"
+        "    <Datei>               Eingabedatei\n"
+        "    --gr\xc3\xb6sse <n>   Schriftgr\xc3\xb6\xc3\x9f" "e\n"
+        "    -\xc3\xa9, --\xc3\xa9tendu    format \xc3\xa9tendu\n"
+        "    -v, --verbose         mehr Ausgaben\n";
+	cmdline::Cmdline cmd(argc, argv, spec, cmdline::Cmdline::FoldCase);
+
+    printf("failed=%s badArgs=%s\n", cmd.failed ? "true" : "false", cmd.badArgs ? "true" : "false");
+    printf("gr\xc3\xb6sse=%s\n", cmd["GR\xc3\x96SSE"].string());
+    printf("\xc3\xa9tendu=%s\n", cmd["\xc3\xa9tendu"].string());
+    printf("verbose=%s\n", cmd["verbose"].string());
+    printf("datei=%s\n", cmd["datei"].string());
+
+    // Invalid argv is reported, and still parsed
+    char* bad[] = { "tool", "--verbose", "caf\xe9.txt" };
+	cmdline::Cmdline strict(3, bad, R"raw(
+    <file>                input
+    -v, --verbose         more output
+)raw");
+    printf("badArgs=%s %s", strict.badArgs ? "true" : "false", strict.errorMsg.c_str());
+    printf("file exists=%s\n", strict["file"].exists() ? "true" : "false");
+
+    printf("\n");
+}
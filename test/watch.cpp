@@ -0,0 +1,144 @@
+#include "cmdline/cmdline.h"
+#include "cmdline/specfile.h"
+#include "cmdline/watch.h"
+#include "bf/AutoRegister.h"
+
+#include <stdio.h>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+extern void PrintArgs(int argc, char* argv[]);
+
+#if !defined(_WIN32)
+namespace
+{
+bool WriteFile(const std::string& path, const std::string& text)
+{
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    fwrite(text.data(), 1, text.size(), f);
+    return fclose(f) == 0;
+}
+
+// Deploy the way a daemon's spec should be replaced, by renaming a new file over it
+bool Deploy(const std::string& path, const std::string& text)
+{
+    return WriteFile(path + ".new", text) && rename((path + ".new").c_str(), path.c_str()) == 0;
+}
+
+// Wait for the watcher to do something, for up to a few seconds
+template<typename F> bool WaitFor(F done)
+{
+    for (int i = 0; i < 300 && !done(); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return done();
+}
+}
+
+AUTO_REGISTER(SpecFiles)
+{
+    printf("-------------------------------------------\n");
+    printf("SpecFiles\n");
+
+    char dirTemplate[] = "/tmp/cmdline-specXXXXXX";
+    std::string dir = mkdtemp(dirTemplate);
+    std::string path = dir + "/server.spec";
+
+    // Exactly a page, without a trailing newline, so the mapping has nothing after
+    // the spec for the parser to run into
+    std::string spec = "    -p, --port <port>     port to listen on (default: 8080)\n    --verbose";
+    spec.insert(spec.find("--verbose"), std::string(4096 - spec.size(), ' '));
+    WriteFile(path, spec);
+
+    auto file = cmdline::SpecFile::open(path.c_str());
+    printf("size=%d mapped=%s\n", (int) file->size(), file->mapped() ? "true" : "false");
+    auto copy = cmdline::SpecFile::read(path.c_str());
+    printf("read: size=%d mapped=%s\n", (int) copy->size(), copy->mapped() ? "true" : "false");
+	int argc = 3;
+	char* argv[] = { "server", "--verbose", "--port=9000" };
+    PrintArgs(argc, argv);
+    {
+        cmdline::Cmdline cmd(file);
+        cmd.eval(argc, argv);
+        printf("failed=%s badArgs=%s port=%s verbose=%s\n", cmd.failed ? "true" : "false", cmd.badArgs ? "true" : "false",
+            cmd["port"].string(), cmd["verbose"].string());
+    }
+    file.reset();
+
+    printf("missing file: %s\n", cmdline::SpecFile::open((dir + "/none.spec").c_str()) ? "opened" : "null");
+    {
+        cmdline::Cmdline cmd(cmdline::SpecFile::open((dir + "/none.spec").c_str()));
+        printf("missing spec: failed=%s %s", cmd.failed ? "true" : "false", cmd.errorMsg.c_str());
+    }
+
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+    printf("\n");
+}
+
+AUTO_REGISTER(WatchedSpec)
+{
+    printf("-------------------------------------------\n");
+    printf("WatchedSpec\n");
+
+    char dirTemplate[] = "/tmp/cmdline-watchXXXXXX";
+    std::string dir = mkdtemp(dirTemplate);
+    std::string path = dir + "/daemon.spec";
+    WriteFile(path, "    -j, --jobs <n>     worker count (default: 4)\n");
+
+    int argc = 3;
+    char* argv[] = { "daemon", "--jobs=8", "--drain" };
+    PrintArgs(argc, argv);
+
+    cmdline::SpecWatcher watcher(path.c_str());
+    auto parse = [&]() {
+        char none[] = "";
+        cmdline::Cmdline cmd(none);
+        cmd.include(watcher.current());
+        cmd.eval(argc, argv);
+        printf("generation %d: badArgs=%s jobs=%s drain=%s\n", watcher.generation(), cmd.badArgs ? "true" : "false",
+            cmd["jobs"].string(), cmd.lookup("drain") >= 0 ? cmd["drain"].string() : "<unknown>");
+    };
+    parse();
+
+    // A reader's group stays as it was while a new one is swapped in
+    auto held = watcher.current();
+    Deploy(path, "    -j, --jobs <n>     worker count (default: 4)\n    --drain            finish work and exit\n");
+    if (!watcher.watching())
+        watcher.reload();
+    bool swapped = WaitFor([&]() { return watcher.generation() == 2; });
+    const char drain[] = "drain";
+    printf("swapped=%s held has drain=%s\n", swapped ? "true" : "false", held->find(drain, drain + 5) != nullptr ? "true" : "false");
+    parse();
+
+    // A spec that doesn't study is reported, and the last good one stays
+    Deploy(path, "    --caf\xff     broken\n");
+    if (!watcher.watching())
+        watcher.reload();
+    WaitFor([&]() { return !watcher.error().empty(); });
+    std::string error = watcher.error();
+    printf("error: ...%s", error.substr(error.find(" didn't")).c_str());
+    parse();
+
+    // Rewriting the file in place is picked up too, and the groups in use keep their text
+    held = watcher.current();
+    WriteFile(path, "    -w, --workers <n>  worker count\n");
+    if (!watcher.watching())
+        watcher.reload();
+    swapped = WaitFor([&]() { return watcher.generation() == 3; });
+    const char jobs[] = "jobs";
+    auto found = held->find(jobs, jobs + 4);
+    printf("swapped=%s held has jobs=%s\n", swapped ? "true" : "false", found != nullptr ? "true" : "false");
+
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+    printf("\n");
+}
+#endif